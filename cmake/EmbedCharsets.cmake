@@ -0,0 +1,29 @@
+# Writes every assets/chars/*.txt into a header of NCMATRIX_CHARSET(id,
+# "name", R"(text)") entries, which src/utils/BuiltinCharsets.h decodes and
+# validates at compile time.
+#
+#   cmake -DCHARSET_DIR=<dir> -DOUTPUT=<file> -P EmbedCharsets.cmake
+
+file(GLOB charset_files "${CHARSET_DIR}/*.txt")
+list(SORT charset_files)
+if (NOT charset_files)
+  message(FATAL_ERROR "No character sets found in ${CHARSET_DIR}")
+endif()
+
+set(content "// Generated from ${CHARSET_DIR} by cmake/EmbedCharsets.cmake. Do not edit.\n\n")
+foreach(charset_file IN LISTS charset_files)
+  get_filename_component(name "${charset_file}" NAME_WE)
+  string(MAKE_C_IDENTIFIER "${name}" id)
+  file(READ "${charset_file}" text)
+  string(FIND "${text}" ")ncmatrix\"" delimiter_found)
+  if (NOT delimiter_found EQUAL -1)
+    message(FATAL_ERROR "${charset_file} contains the raw string delimiter )ncmatrix\"")
+  endif()
+  string(APPEND content "NCMATRIX_CHARSET(${id}, \"${name}\", R\"ncmatrix(${text})ncmatrix\")\n")
+endforeach()
+
+# Only touch the output when it changes, so unrelated edits do not rebuild
+# everything that includes it.
+file(WRITE "${OUTPUT}.tmp" "${content}")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
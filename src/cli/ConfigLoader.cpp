@@ -1,15 +1,24 @@
 #include "cli/ConfigLoader.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 #include <toml.hpp>
 
+#include "utils/BuiltinCharsets.h"
+#include "utils/SnapshotIo.h"
+#include "utils/Utf8.h"
+
 namespace {
 float get_float(const toml::table& table, std::string_view key, float fallback) {
     if (const auto value = table[key].value<double>()) {
@@ -48,7 +57,31 @@ uint32_t get_color(const toml::table& table, std::string_view key, uint32_t fall
     return fallback;
 }
 
+bool check_builtin_charset(std::string_view reference) {
+    if (!builtin_charsets::find(reference).empty()) {
+        return true;
+    }
+    std::cerr << "Unknown character set '" << reference << "'; built-in sets are:";
+    for (const auto& charset : builtin_charsets::kAll) {
+        std::cerr << ' ' << builtin_charsets::kPrefix << charset.name;
+    }
+    std::cerr << "\n";
+    return false;
+}
+
 void populate_character_set(const toml::table& table, RainConfig& config) {
+    // A string is either a built-in set or the glyphs themselves.
+    if (const auto text = table["characterSet"].value<std::string>()) {
+        if (builtin_charsets::is_reference(*text)) {
+            if (check_builtin_charset(*text)) {
+                const auto* builtin = builtin_charsets::lookup(*text);
+                set_character_set(config, builtin->glyphs, builtin->weights);
+            }
+        } else if (!text->empty()) {
+            config.characterSet = utf8::decode(*text);
+        }
+        return;
+    }
     if (const auto* array = table["characterSet"].as_array()) {
         std::vector<char32_t> characters;
         characters.reserve(array->size());
@@ -69,6 +102,81 @@ void populate_character_set(const toml::table& table, RainConfig& config) {
     }
 }
 
+std::optional<double> get_number(const toml::node& node) {
+    if (const auto value = node.value<double>()) {
+        return *value;
+    }
+    if (const auto value_int = node.value<std::int64_t>()) {
+        return static_cast<double>(*value_int);
+    }
+    return std::nullopt;
+}
+
+// A curve is either an array of [time, value] pairs, or a table with such an
+// array under `keys` plus `loop` (repeat after the last key) and `ease`
+// ("linear" or "smooth").
+bool read_curve(const toml::node& node, std::string_view name, std::vector<std::pair<float, double>>& keys, bool& loop, bool& smooth) {
+    const toml::array* array = node.as_array();
+    loop = false;
+    smooth = false;
+    if (const auto* table = node.as_table()) {
+        array = (*table)["keys"].as_array();
+        loop = (*table)["loop"].value_or(false);
+        smooth = (*table)["ease"].value_or(std::string{"linear"}) == "smooth";
+    }
+
+    keys.clear();
+    if (array != nullptr) {
+        for (const auto& entry : *array) {
+            const auto* pair = entry.as_array();
+            if (pair == nullptr || pair->size() != 2) {
+                continue;
+            }
+            const auto time = get_number(*pair->get(0));
+            const auto value = get_number(*pair->get(1));
+            if (time && value) {
+                keys.emplace_back(static_cast<float>(*time), *value);
+            }
+        }
+    }
+    if (keys.empty()) {
+        std::cerr << "Ignoring curve '" << name << "': expected [[time, value], ...].\n";
+        return false;
+    }
+    return true;
+}
+
+void load_rain_curves(const toml::table& table, RainCurves& curves) {
+    std::vector<std::pair<float, double>> keys;
+    bool loop = false;
+    bool smooth = false;
+    const auto load = [&](std::string_view name, Curve& curve) {
+        if (const auto* node = table.get(name); node != nullptr && read_curve(*node, name, keys, loop, smooth)) {
+            std::vector<CurveKey> curve_keys;
+            for (const auto& [time, value] : keys) {
+                curve_keys.push_back(CurveKey{time, static_cast<float>(value)});
+            }
+            curve = Curve(std::move(curve_keys), loop, smooth);
+        }
+    };
+    const auto load_color = [&](std::string_view name, ColorCurve& curve) {
+        if (const auto* node = table.get(name); node != nullptr && read_curve(*node, name, keys, loop, smooth)) {
+            std::vector<std::pair<float, uint32_t>> color_keys;
+            for (const auto& [time, value] : keys) {
+                color_keys.emplace_back(time, static_cast<uint32_t>(value));
+            }
+            curve = ColorCurve(color_keys, loop, smooth);
+        }
+    };
+
+    load("density", curves.density);
+    load("minSpeed", curves.minSpeed);
+    load("maxSpeed", curves.maxSpeed);
+    load("slantAngle", curves.slantAngle);
+    load_color("leadCharColor", curves.leadCharColor);
+    load_color("tailColor", curves.tailColor);
+}
+
 void load_rain_settings(const toml::table& table, RainConfig& config, const std::filesystem::path& root_path) {
     config.slantAngle = get_float(table, "slantAngle", config.slantAngle);
     config.duration = get_float(table, "duration", config.duration);
@@ -79,22 +187,123 @@ void load_rain_settings(const toml::table& table, RainConfig& config, const std:
     config.density = get_float(table, "density", config.density);
 
     if (const auto character_file = table["characterSetFile"].value<std::string>()) {
-        std::filesystem::path character_path{*character_file};
-        if (character_path.is_relative()) {
-            character_path = root_path.parent_path() / character_path;
+        if (builtin_charsets::is_reference(*character_file)) {
+            if (check_builtin_charset(*character_file)) {
+                config.characterSetFile = *character_file;
+            }
+        } else {
+            std::filesystem::path character_path{*character_file};
+            if (character_path.is_relative()) {
+                character_path = root_path.parent_path() / character_path;
+            }
+            std::error_code exists_error;
+            if (!std::filesystem::exists(character_path, exists_error)) {
+                std::cerr << "Character set file '" << character_path.string()
+                          << "' not found; using the built-in fallback glyphs.\n";
+            }
+            config.characterSetFile = character_path.string();
         }
-        config.characterSetFile = character_path.string();
     }
 
     config.leadCharColor = get_color(table, "leadCharColor", config.leadCharColor);
     config.tailColor = get_color(table, "tailColor", config.tailColor);
+    config.audioDensity = std::clamp(get_float(table, "audioDensity", config.audioDensity), 0.0f, 1.0f);
+    config.audioSpeed = std::clamp(get_float(table, "audioSpeed", config.audioSpeed), 0.0f, 1.0f);
+    config.audioBrightness = std::clamp(get_float(table, "audioBrightness", config.audioBrightness), 0.0f, 1.0f);
 
     populate_character_set(table, config);
 
+    if (const auto* curves_table = table["curves"].as_table()) {
+        load_rain_curves(*curves_table, config.curves);
+    }
+    if (const auto phosphor = table["phosphor"].value<bool>()) {
+        config.phosphor = *phosphor;
+    }
+    config.phosphorDecay = get_float(table, "phosphorDecay", config.phosphorDecay);
+
     // Alternate naming for integrated effect configuration.
     config.duration = get_float(table, "rain_duration", config.duration);
 }
 
+void load_pixel_rain_settings(const toml::table& table, PixelRainConfig& config, const std::filesystem::path& root_path) {
+    load_rain_settings(table, config.rainConfig, root_path);
+    if (const auto blitter = table["blitter"].value<std::string>()) {
+        if (*blitter == "quadrant") {
+            config.blitter = PixelBlitter::Quadrant;
+        } else if (*blitter == "sextant") {
+            config.blitter = PixelBlitter::Sextant;
+        } else if (*blitter == "braille") {
+            config.blitter = PixelBlitter::Braille;
+        } else if (*blitter == "pixel") {
+            config.blitter = PixelBlitter::Pixel;
+        } else {
+            std::cerr << "Unknown pixel_rain blitter '" << *blitter << "', using sextant.\n";
+        }
+    }
+}
+
+void load_postprocess_settings(const toml::table& table, BloomConfig& config) {
+    if (const auto enabled = table["bloom"].value<bool>()) {
+        config.enabled = *enabled;
+    }
+    config.threshold = std::clamp(get_float(table, "bloomThreshold", config.threshold), 0.0f, 1.0f);
+    config.radius = std::clamp(get_int(table, "bloomRadius", config.radius), 1, 4);
+    config.intensity = std::max(0.0f, get_float(table, "bloomIntensity", config.intensity));
+    config.color = get_color(table, "bloomColor", config.color);
+}
+
+void load_output_settings(const toml::table& table, OutputConfig& config) {
+    if (const auto enabled = table["budget"].value<bool>()) {
+        config.budgetEnabled = *enabled;
+    }
+    config.budget.fadeLevels = std::max(0, get_int(table, "fadeLevels", config.budget.fadeLevels));
+    if (const auto palette = table["palette256"].value<bool>()) {
+        config.budget.palette256 = *palette;
+    }
+    if (const auto report = table["reportStats"].value<bool>()) {
+        config.reportStats = *report;
+    }
+}
+
+void load_governor_settings(const toml::table& table, GovernorConfig& config) {
+    config.frameBudgetMs = std::max(0.0f, get_float(table, "frameBudgetMs", config.frameBudgetMs));
+    config.degradeFrames = std::max(1, get_int(table, "degradeFrames", config.degradeFrames));
+    config.recoverFrames = std::max(1, get_int(table, "recoverFrames", config.recoverFrames));
+    config.recoverRatio = std::clamp(get_float(table, "recoverRatio", config.recoverRatio), 0.0f, 1.0f);
+}
+
+void load_snapshot_settings(const toml::table& table, SnapshotConfig& config, const std::filesystem::path& root_path) {
+    if (const auto file = table["snapshotFile"].value<std::string>(); file && !file->empty()) {
+        std::filesystem::path snapshot{*file};
+        if (snapshot.is_relative()) {
+            snapshot = root_path.parent_path() / snapshot;
+        }
+        config.path = snapshot.string();
+    }
+    config.interval = std::max(0.1f, get_float(table, "snapshotInterval", config.interval));
+}
+
+uint64_t hash_file(const std::filesystem::path& path) {
+    std::ifstream input(path, std::ios::binary);
+    const std::vector<uint8_t> bytes{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    return snapshot_hash(bytes);
+}
+
+void load_audio_settings(const toml::table& table, AudioConfig& config, const std::filesystem::path& root_path) {
+    if (const auto file = table["file"].value<std::string>()) {
+        std::filesystem::path source{*file};
+        if (source.is_relative()) {
+            source = root_path.parent_path() / source;
+        }
+        config.source = source.string();
+    }
+    config.sampleRate = static_cast<unsigned int>(std::max(1, get_int(table, "sampleRate", static_cast<int>(config.sampleRate))));
+    config.channels = static_cast<unsigned int>(std::clamp(get_int(table, "channels", static_cast<int>(config.channels)), 1, 8));
+    if (const auto loop = table["loop"].value<bool>()) {
+        config.loop = *loop;
+    }
+}
+
 std::u32string utf8_to_u32(const std::string& input) {
     std::u32string result;
     result.reserve(input.size());
@@ -104,6 +313,157 @@ std::u32string utf8_to_u32(const std::string& input) {
     return result;
 }
 
+
+AnimationType read_animation(const toml::table& table, AnimationType fallback) {
+    if (const auto animation_value = table["animation"].value<std::string>()) {
+        if (*animation_value == "rain_and_converge") {
+            return AnimationType::RainAndConverge;
+        }
+        if (*animation_value == "pixel_rain") {
+            return AnimationType::PixelRain;
+        }
+        return AnimationType::Rain;
+    }
+    return fallback;
+}
+
+void load_rain_and_converge_settings(const toml::table& table, RainAndConvergeConfig& config, const std::filesystem::path& root_path) {
+    load_rain_settings(table, config.rainConfig, root_path);
+    if (const auto title_value = table["title"].value<std::string>()) {
+        config.title = utf8_to_u32(*title_value);
+    }
+    if (const auto* titles = table["titles"].as_array()) {
+        config.titleQueue.clear();
+        for (const auto& entry : *titles) {
+            if (const auto text = entry.value<std::string>()) {
+                config.titleQueue.push_back(utf8_to_u32(*text));
+            }
+        }
+    }
+    config.titleHold = get_float(table, "title_hold", config.titleHold);
+    config.convergenceDuration = get_float(table, "convergence_duration", config.convergenceDuration);
+    config.convergenceRandomness = get_float(table, "convergence_randomness", config.convergenceRandomness);
+    if (const auto mask_value = table["mask_file"].value<std::string>()) {
+        std::filesystem::path mask_path = *mask_value;
+        if (mask_path.is_relative()) {
+            mask_path = root_path.parent_path() / mask_path;
+        }
+        config.maskFile = mask_path.string();
+    }
+    if (const auto over_value = table["rain_over_title"].value<bool>()) {
+        config.rainOverTitle = *over_value;
+    }
+    const int row_hint = get_int(table, "title_row", static_cast<int>(config.titleRow));
+    if (row_hint > 0) {
+        config.titleRow = static_cast<unsigned int>(row_hint);
+    }
+}
+
+void load_animation_settings(const toml::table& table, AnimationType animation, SceneConfig& sceneConfig, const std::filesystem::path& path) {
+    if (animation == AnimationType::RainAndConverge) {
+        if (const auto* rac_table = table["rain_and_converge"].as_table()) {
+            load_rain_and_converge_settings(*rac_table, sceneConfig.rainAndConverge, path);
+        }
+    } else if (animation == AnimationType::PixelRain) {
+        if (const auto* pixel_table = table["effect"]["pixel_rain"].as_table()) {
+            load_pixel_rain_settings(*pixel_table, sceneConfig.pixelRain, path);
+        }
+    } else if (const auto* rain_table = table["effect"]["cyberrain"].as_table()) {
+        load_rain_settings(*rain_table, sceneConfig.rain, path);
+    }
+}
+
+void load_pane_schedule(const toml::table& table, PaneConfig& pane) {
+    pane.z = get_int(table, "z", pane.z);
+    pane.updateRate = std::max(0.0f, get_float(table, "updateRate", pane.updateRate));
+    pane.budgetMs = std::max(0.0f, get_float(table, "budgetMs", pane.budgetMs));
+}
+
+// A pane starts as a copy of its animation's settings. The glyph set is
+// loaded into the base settings first so that every copy shares it.
+PaneSceneConfig make_pane(AnimationType animation, SceneConfig& sceneConfig) {
+    PaneSceneConfig pane;
+    pane.animation = animation;
+    if (animation == AnimationType::RainAndConverge) {
+        share_glyph_set(sceneConfig.rainAndConverge.rainConfig);
+        pane.rainAndConverge = sceneConfig.rainAndConverge;
+    } else if (animation == AnimationType::PixelRain) {
+        pane.pixelRain = sceneConfig.pixelRain;
+    } else {
+        share_glyph_set(sceneConfig.rain);
+        pane.rain = sceneConfig.rain;
+    }
+    return pane;
+}
+
+// [layout] grid = [columns, rows] tiles the screen with the scene animation.
+void load_grid_panes(const toml::table& table, SceneConfig& sceneConfig) {
+    const auto* grid = table["grid"].as_array();
+    if (grid == nullptr) {
+        return;
+    }
+    const auto columns = grid->size() == 2 ? get_number(*grid->get(0)) : std::nullopt;
+    const auto rows = grid->size() == 2 ? get_number(*grid->get(1)) : std::nullopt;
+    if (!columns || !rows || *columns < 1.0 || *rows < 1.0) {
+        std::cerr << "Ignoring layout grid: expected [columns, rows].\n";
+        return;
+    }
+    const int grid_columns = static_cast<int>(*columns);
+    const int grid_rows = static_cast<int>(*rows);
+    PaneSceneConfig pane = make_pane(sceneConfig.animation, sceneConfig);
+    load_pane_schedule(table, pane.pane);
+    pane.pane.width = 1.0f / static_cast<float>(grid_columns);
+    pane.pane.height = 1.0f / static_cast<float>(grid_rows);
+    sceneConfig.panes.reserve(sceneConfig.panes.size() + static_cast<std::size_t>(grid_columns * grid_rows));
+    for (int row = 0; row < grid_rows; ++row) {
+        for (int column = 0; column < grid_columns; ++column) {
+            pane.pane.x = static_cast<float>(column) * pane.pane.width;
+            pane.pane.y = static_cast<float>(row) * pane.pane.height;
+            sceneConfig.panes.push_back(pane);
+        }
+    }
+}
+
+// [[pane]] places one effect: `animation` (the scene's by default),
+// `region` = [x, y, width, height] as fractions of the screen, `z`,
+// `updateRate`, `budgetMs`, and any key of the animation's own section.
+void load_pane(const toml::table& table, SceneConfig& sceneConfig, const std::filesystem::path& path) {
+    PaneSceneConfig pane = make_pane(read_animation(table, sceneConfig.animation), sceneConfig);
+    load_pane_schedule(table, pane.pane);
+    if (const auto* region = table["region"].as_array()) {
+        std::vector<float> edges;
+        for (const auto& node : *region) {
+            if (const auto value = get_number(node)) {
+                edges.push_back(std::clamp(static_cast<float>(*value), 0.0f, 1.0f));
+            }
+        }
+        if (edges.size() == 4 && edges[2] > 0.0f && edges[3] > 0.0f) {
+            pane.pane.x = edges[0];
+            pane.pane.y = edges[1];
+            pane.pane.width = edges[2];
+            pane.pane.height = edges[3];
+        } else {
+            std::cerr << "Ignoring pane region: expected [x, y, width, height] as fractions of the screen.\n";
+        }
+    }
+
+    // A pane with its own glyphs stops sharing the base set.
+    const bool own_glyphs = table.contains("characterSet") || table.contains("characterSetFile");
+    if (pane.animation == AnimationType::RainAndConverge) {
+        if (own_glyphs) {
+            pane.rainAndConverge.rainConfig.glyphSet.reset();
+        }
+        load_rain_and_converge_settings(table, pane.rainAndConverge, path);
+    } else if (pane.animation == AnimationType::PixelRain) {
+        load_pixel_rain_settings(table, pane.pixelRain, path);
+    } else {
+        if (own_glyphs) {
+            pane.rain.glyphSet.reset();
+        }
+        load_rain_settings(table, pane.rain, path);
+    }
+    sceneConfig.panes.push_back(std::move(pane));
+}
 } // namespace
 
 SceneConfig load_scene_config_from_file(const std::filesystem::path& path) {
@@ -119,35 +479,53 @@ SceneConfig load_scene_config_from_file(const std::filesystem::path& path) {
 
     try {
         const toml::table table = toml::parse_file(path.string());
+        sceneConfig.snapshot.configDigest = hash_file(path);
 
         if (const auto* scene_table = table["scene"].as_table()) {
-            if (const auto animation_value = (*scene_table)["animation"].value<std::string>()) {
-                if (*animation_value == "rain_and_converge") {
-                    sceneConfig.animation = AnimationType::RainAndConverge;
-                } else {
-                    sceneConfig.animation = AnimationType::Rain;
-                }
-            }
+            sceneConfig.animation = read_animation(*scene_table, sceneConfig.animation);
         }
 
-        if (sceneConfig.animation == AnimationType::RainAndConverge) {
-            if (const auto* rac_table = table["rain_and_converge"].as_table()) {
-                load_rain_settings(*rac_table, sceneConfig.rainAndConverge.rainConfig, path);
-                if (const auto title_value = (*rac_table)["title"].value<std::string>()) {
-                    sceneConfig.rainAndConverge.title = utf8_to_u32(*title_value);
-                }
-                sceneConfig.rainAndConverge.convergenceDuration = get_float(*rac_table, "convergence_duration", sceneConfig.rainAndConverge.convergenceDuration);
-                sceneConfig.rainAndConverge.convergenceRandomness = get_float(*rac_table, "convergence_randomness", sceneConfig.rainAndConverge.convergenceRandomness);
-                const int row_hint = get_int(*rac_table, "title_row", static_cast<int>(sceneConfig.rainAndConverge.titleRow));
-                if (row_hint > 0) {
-                    sceneConfig.rainAndConverge.titleRow = static_cast<unsigned int>(row_hint);
+        if (const auto* engine_table = table["engine"].as_table()) {
+            load_governor_settings(*engine_table, sceneConfig.governor);
+            sceneConfig.rasterThreads = static_cast<unsigned int>(std::max(0, get_int(*engine_table, "rasterThreads", 0)));
+            load_snapshot_settings(*engine_table, sceneConfig.snapshot, path);
+        }
+
+        if (const auto* audio_table = table["audio"].as_table()) {
+            load_audio_settings(*audio_table, sceneConfig.audio, path);
+        }
+
+        if (const auto* output_table = table["output"].as_table()) {
+            load_output_settings(*output_table, sceneConfig.output);
+        }
+
+        if (const auto* postprocess_table = table["postprocess"].as_table()) {
+            load_postprocess_settings(*postprocess_table, sceneConfig.bloom);
+        }
+
+        // Each animation in use starts from its own section.
+        std::vector<AnimationType> used{sceneConfig.animation};
+        const toml::array* pane_array = table["pane"].as_array();
+        if (pane_array != nullptr) {
+            for (const auto& node : *pane_array) {
+                if (const auto* pane_table = node.as_table()) {
+                    used.push_back(read_animation(*pane_table, sceneConfig.animation));
                 }
             }
-        } else {
-            const toml::node_view effect = table["effect"];
-            if (const auto* effect_table = effect.as_table()) {
-                if (const auto* rain_table = (*effect_table)["cyberrain"].as_table()) {
-                    load_rain_settings(*rain_table, sceneConfig.rain, path);
+        }
+        for (const AnimationType animation : {AnimationType::Rain, AnimationType::RainAndConverge, AnimationType::PixelRain}) {
+            if (std::find(used.begin(), used.end(), animation) != used.end()) {
+                load_animation_settings(table, animation, sceneConfig, path);
+            }
+        }
+
+        if (const auto* layout_table = table["layout"].as_table()) {
+            load_grid_panes(*layout_table, sceneConfig);
+        }
+        if (pane_array != nullptr) {
+            for (const auto& node : *pane_array) {
+                if (const auto* pane_table = node.as_table()) {
+                    load_pane(*pane_table, sceneConfig, path);
                 }
             }
         }
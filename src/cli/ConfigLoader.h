@@ -1,19 +1,44 @@
 #pragma once
 
+#include "effects/PixelRainEffect.h"
 #include "effects/RainAndConvergeEffect.h"
 #include "effects/RainEffect.h"
+#include "engine/EffectManager.h"
+#include "engine/Engine.h"
 
 #include <filesystem>
+#include <vector>
 
 enum class AnimationType {
     Rain,
     RainAndConverge,
+    PixelRain,
+};
+
+// One effect of a multi-pane scene: where it goes, and its settings, which
+// are its animation's section with the pane's own keys applied on top.
+struct PaneSceneConfig {
+    AnimationType animation{AnimationType::Rain};
+    PaneConfig pane{};
+    RainConfig rain{};
+    RainAndConvergeConfig rainAndConverge{};
+    PixelRainConfig pixelRain{};
 };
 
 struct SceneConfig {
     AnimationType animation{AnimationType::Rain};
     RainConfig rain{};
     RainAndConvergeConfig rainAndConverge{};
+    PixelRainConfig pixelRain{};
+    OutputConfig output{};
+    GovernorConfig governor{};
+    BloomConfig bloom{};
+    unsigned int rasterThreads{0};
+    AudioConfig audio{};
+    // configDigest is a hash of the configuration file.
+    SnapshotConfig snapshot{};
+    // From [layout] and [[pane]]; empty for one full-screen `animation`.
+    std::vector<PaneSceneConfig> panes{};
 };
 
 SceneConfig load_scene_config_from_file(const std::filesystem::path& path);
@@ -1,19 +1,46 @@
 #include "cli/ConfigLoader.h"
+#include "engine/BroadcastServer.h"
+#include "engine/FrameExport.h"
+#include "utils/AllocationTracker.h"
 #include "engine/Engine.h"
+#include "effects/PixelRainEffect.h"
 #include "effects/RainAndConvergeEffect.h"
 #include "effects/RainEffect.h"
 
 #include <cxxopts.hpp>
 
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <memory>
 #include <string>
 
+namespace {
+std::unique_ptr<Effect> make_effect(AnimationType animation, RainConfig&& rain, RainAndConvergeConfig&& rain_and_converge,
+                                    PixelRainConfig&& pixel_rain) {
+    if (animation == AnimationType::RainAndConverge) {
+        return std::make_unique<RainAndConvergeEffect>(std::move(rain_and_converge));
+    }
+    if (animation == AnimationType::PixelRain) {
+        return std::make_unique<PixelRainEffect>(std::move(pixel_rain));
+    }
+    return std::make_unique<RainEffect>(std::move(rain));
+}
+} // namespace
+
 int main(int argc, char** argv) {
     cxxopts::Options options("ncmatrix", "Digital rain effect renderer");
     options.add_options()
         ("c,config", "Path to configuration file", cxxopts::value<std::string>()->default_value("matrix.toml"))
+        ("broadcast", "Serve rendered frames to viewers on this Unix socket", cxxopts::value<std::string>())
+        ("view", "Attach to a broadcasting instance on this Unix socket", cxxopts::value<std::string>())
+        ("export-frames", "Publish composited frames to a shared-memory ring with this name", cxxopts::value<std::string>())
+        ("frames", "Run exactly this many frames at a fixed 60 Hz step, then exit", cxxopts::value<std::uint64_t>())
+        ("seed", "Seed for the random number generator", cxxopts::value<std::uint32_t>())
+        ("seekable", "Run on a scene clock that the arrow keys can move")
+        ("start-at", "Start a seekable run at this scene time in seconds", cxxopts::value<float>())
+        ("audio", "Drive the rain from a WAV file or a named pipe of PCM", cxxopts::value<std::string>())
+        ("snapshot", "Save the scene to this file now and then, and resume from it on startup", cxxopts::value<std::string>())
         ("h,help", "Print usage information");
 
     cxxopts::ParseResult result;
@@ -29,15 +56,94 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    if (result.count("start-at")) {
+        const float start = result["start-at"].as<float>();
+        if (!(start >= 0.0f && start <= Engine::kMaxStartTime)) {
+            std::cerr << "Failed to parse command line: --start-at must be between 0 and " << Engine::kMaxStartTime
+                      << " seconds\n";
+            return 1;
+        }
+    }
+
+    if (result.count("view")) {
+        return run_broadcast_viewer(result["view"].as<std::string>());
+    }
+
+    std::unique_ptr<BroadcastServer> broadcast;
+    if (result.count("broadcast")) {
+        broadcast = std::make_unique<BroadcastServer>(result["broadcast"].as<std::string>());
+        std::string error;
+        if (!broadcast->start(error)) {
+            std::cerr << "Failed to start broadcast server: " << error << '\n';
+            return 1;
+        }
+    }
+
+    std::unique_ptr<FrameExport> frame_export;
+    if (result.count("export-frames")) {
+        frame_export = std::make_unique<FrameExport>(result["export-frames"].as<std::string>());
+        std::string error;
+        if (!frame_export->start(error)) {
+            std::cerr << "Failed to start frame export: " << error << '\n';
+            return 1;
+        }
+    }
+
     const std::filesystem::path config_path = result["config"].as<std::string>();
     SceneConfig scene_config = load_scene_config_from_file(config_path);
+    if (result.count("audio")) {
+        scene_config.audio.source = result["audio"].as<std::string>();
+    }
+    if (result.count("snapshot")) {
+        scene_config.snapshot.path = result["snapshot"].as<std::string>();
+    }
+
+    std::unique_ptr<AudioAnalyzer> audio;
+    if (!scene_config.audio.source.empty()) {
+        audio = std::make_unique<AudioAnalyzer>(scene_config.audio);
+        std::string error;
+        if (!audio->start(error)) {
+            std::cerr << "Failed to start audio input: " << error << '\n';
+            return 1;
+        }
+    }
+
+    {
+        Engine engine;
+        engine.set_broadcast_server(std::move(broadcast));
+        engine.set_frame_export(std::move(frame_export));
+        engine.set_audio_analyzer(std::move(audio));
+        engine.set_output_config(scene_config.output);
+        engine.set_governor_config(scene_config.governor);
+        engine.set_bloom_config(scene_config.bloom);
+        engine.set_raster_threads(scene_config.rasterThreads);
+        engine.set_snapshot_config(scene_config.snapshot);
+        if (result.count("seed")) {
+            engine.set_seed(result["seed"].as<std::uint32_t>());
+        }
+        if (result.count("frames")) {
+            engine.set_frame_limit(result["frames"].as<std::uint64_t>());
+        }
+        if (result.count("seekable") || result.count("start-at")) {
+            engine.set_seekable(true);
+        }
+        if (result.count("start-at")) {
+            engine.set_start_time(result["start-at"].as<float>());
+        }
+        if (scene_config.panes.empty()) {
+            engine.add_effect(make_effect(scene_config.animation, std::move(scene_config.rain),
+                                          std::move(scene_config.rainAndConverge), std::move(scene_config.pixelRain)));
+        }
+        for (PaneSceneConfig& pane : scene_config.panes) {
+            engine.add_effect(make_effect(pane.animation, std::move(pane.rain), std::move(pane.rainAndConverge),
+                                          std::move(pane.pixelRain)),
+                              pane.pane);
+        }
+        engine.run();
+    }
 
-    Engine engine;
-    if (scene_config.animation == AnimationType::RainAndConverge) {
-        engine.add_effect(std::make_unique<RainAndConvergeEffect>(std::move(scene_config.rainAndConverge)));
-    } else {
-        engine.add_effect(std::make_unique<RainEffect>(std::move(scene_config.rain)));
+    if (alloc_tracking::kEnabled && !alloc_tracking::report(std::cerr)) {
+        return 2;
     }
-    engine.run();
     return 0;
 }
@@ -0,0 +1,119 @@
+#include "effects/ConvergeMask.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+
+#include <notcurses/notcurses.h>
+
+#include "utils/Utf8.h"
+
+namespace {
+constexpr uint32_t kOpaqueAlpha = 128;
+constexpr uint32_t kBrightLuminance = 128;
+
+bool has_extension(const std::string& path, const std::string& extension) {
+    return path.size() >= extension.size() &&
+           std::equal(extension.rbegin(), extension.rend(), path.rbegin(),
+                      [](char a, char b) { return a == static_cast<char>(std::tolower(static_cast<unsigned char>(b))); });
+}
+
+bool load_text_mask(const std::string& path, ConvergeMask& mask) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open()) {
+        return false;
+    }
+
+    std::vector<std::vector<char32_t>> lines;
+    std::string line;
+    std::size_t width = 0;
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        auto decoded = utf8::decode(line);
+        while (!decoded.empty() && decoded.back() == U' ') {
+            decoded.pop_back();
+        }
+        width = std::max(width, decoded.size());
+        lines.push_back(std::move(decoded));
+    }
+    while (!lines.empty() && lines.back().empty()) {
+        lines.pop_back();
+    }
+
+    mask.rows = static_cast<unsigned int>(lines.size());
+    mask.cols = static_cast<unsigned int>(width);
+    mask.cells.assign(static_cast<std::size_t>(mask.rows) * mask.cols, U'\0');
+    for (std::size_t y = 0; y < lines.size(); ++y) {
+        for (std::size_t x = 0; x < lines[y].size(); ++x) {
+            const char32_t glyph = lines[y][x];
+            if (glyph != U' ' && glyph != U'\t') {
+                mask.cells[y * mask.cols + x] = glyph;
+            }
+        }
+    }
+    return !mask.empty();
+}
+
+bool load_image_mask(const std::string& path, unsigned int max_rows, unsigned int max_cols,
+                     const std::vector<char32_t>& charset, const AliasTable& weights, std::mt19937& rng,
+                     ConvergeMask& mask) {
+    struct ncvisual* visual = ncvisual_from_file(path.c_str());
+    if (visual == nullptr) {
+        return false;
+    }
+
+    ncvgeom geom{};
+    if (ncvisual_geom(nullptr, visual, nullptr, &geom) != 0 || geom.pixy == 0 || geom.pixx == 0) {
+        ncvisual_destroy(visual);
+        return false;
+    }
+
+    // One pixel per cell; halve the height so the shape keeps its aspect.
+    const float source_rows = static_cast<float>(geom.pixy) / 2.0f;
+    const float fit = std::min(static_cast<float>(max_cols) / static_cast<float>(geom.pixx),
+                               static_cast<float>(max_rows) / source_rows);
+    mask.cols = std::max(1U, static_cast<unsigned int>(static_cast<float>(geom.pixx) * fit));
+    mask.rows = std::max(1U, static_cast<unsigned int>(source_rows * fit));
+    if (ncvisual_resize_noninterpolative(visual, static_cast<int>(mask.rows), static_cast<int>(mask.cols)) != 0) {
+        ncvisual_destroy(visual);
+        return false;
+    }
+
+    mask.cells.assign(static_cast<std::size_t>(mask.rows) * mask.cols, U'\0');
+    for (unsigned int y = 0; y < mask.rows; ++y) {
+        for (unsigned int x = 0; x < mask.cols; ++x) {
+            uint32_t pixel = 0;
+            if (ncvisual_at_yx(visual, y, x, &pixel) != 0) {
+                continue;
+            }
+            // ncvisual pixels are stored as 0xAABBGGRR.
+            const uint32_t r = pixel & 0xFFU;
+            const uint32_t g = (pixel >> 8U) & 0xFFU;
+            const uint32_t b = (pixel >> 16U) & 0xFFU;
+            const uint32_t a = pixel >> 24U;
+            const uint32_t luminance = (54U * r + 183U * g + 19U * b) >> 8U;
+            if (a >= kOpaqueAlpha && luminance >= kBrightLuminance) {
+                mask.cells[static_cast<std::size_t>(y) * mask.cols + x] = charset.empty() ? U'#' : charset[weights.sample(rng)];
+            }
+        }
+    }
+    ncvisual_destroy(visual);
+    return true;
+}
+} // namespace
+
+bool load_converge_mask(const std::string& path, unsigned int max_rows, unsigned int max_cols,
+                        const std::vector<char32_t>& charset, const AliasTable& weights, std::mt19937& rng,
+                        ConvergeMask& mask) {
+    mask = ConvergeMask{};
+    if (path.empty() || max_rows == 0 || max_cols == 0) {
+        return false;
+    }
+    if (has_extension(path, ".txt")) {
+        return load_text_mask(path, mask);
+    }
+    return load_image_mask(path, max_rows, max_cols, charset, weights, rng, mask);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utils/AliasTable.h"
+
+// Shape that the title particles converge into, row-major. U'\0' marks a cell
+// without a target.
+struct ConvergeMask {
+    unsigned int rows{0};
+    unsigned int cols{0};
+    std::vector<char32_t> cells{};
+
+    bool empty() const { return rows == 0 || cols == 0; }
+};
+
+// Loads `path` as a mask no larger than `max_rows` x `max_cols`. Files ending in
+// .txt are text art: every non-space character becomes a target showing that
+// character. Anything else is decoded as an image through notcurses (which
+// needs multimedia support) and scaled to fit, assuming cells are twice as
+// tall as they are wide; opaque, bright pixels become targets with glyphs from
+// `charset`, drawn by `weights`. Returns false if nothing could be loaded.
+bool load_converge_mask(const std::string& path, unsigned int max_rows, unsigned int max_cols,
+                        const std::vector<char32_t>& charset, const AliasTable& weights, std::mt19937& rng,
+                        ConvergeMask& mask);
@@ -0,0 +1,301 @@
+#include "effects/ParticleSystem.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+char32_t pick_glyph(const std::vector<char32_t>& charset, const AliasTable& weights, std::mt19937& rng) {
+    if (charset.empty()) {
+        return U' ';
+    }
+    return charset[weights.sample(rng)];
+}
+} // namespace
+
+void ParticlePool::reset(std::size_t capacity, std::size_t trail_capacity) {
+    trail_capacity_ = std::max<std::size_t>(1, trail_capacity);
+    hot.x.assign(capacity, 0.0f);
+    hot.y.assign(capacity, 0.0f);
+    hot.vy.assign(capacity, 0.0f);
+    cold.assign(capacity, Cold{});
+    trail_glyphs_.assign(capacity * trail_capacity_, U' ');
+    live_index_.assign(capacity, 0);
+    live_.clear();
+    live_.reserve(capacity);
+    free_.clear();
+    free_.reserve(capacity);
+    clear();
+}
+
+void ParticlePool::clear() {
+    live_.clear();
+    free_.clear();
+    for (std::size_t i = capacity(); i > 0; --i) {
+        free_.push_back(static_cast<Handle>(i - 1));
+    }
+}
+
+void ParticlePool::grow(std::size_t new_capacity) {
+    const std::size_t old_capacity = capacity();
+    if (new_capacity <= old_capacity) {
+        return;
+    }
+    hot.x.resize(new_capacity, 0.0f);
+    hot.y.resize(new_capacity, 0.0f);
+    hot.vy.resize(new_capacity, 0.0f);
+    cold.resize(new_capacity, Cold{});
+    trail_glyphs_.resize(new_capacity * trail_capacity_, U' ');
+    live_index_.resize(new_capacity, 0);
+    live_.reserve(new_capacity);
+    free_.reserve(new_capacity);
+    for (std::size_t i = new_capacity; i > old_capacity; --i) {
+        free_.push_back(static_cast<Handle>(i - 1));
+    }
+}
+
+void ParticlePool::reserve_like(const ParticlePool& other) {
+    live_.reserve(other.capacity());
+    free_.reserve(other.capacity());
+}
+
+ParticlePool::Handle ParticlePool::spawn() {
+    if (free_.empty()) {
+        return kInvalidHandle;
+    }
+    const Handle handle = free_.back();
+    free_.pop_back();
+    live_index_[handle] = static_cast<uint32_t>(live_.size());
+    live_.push_back(handle);
+    return handle;
+}
+
+void ParticlePool::retire(Handle handle) {
+    const uint32_t index = live_index_[handle];
+    const Handle moved = live_.back();
+    live_[index] = moved;
+    live_index_[moved] = index;
+    live_.pop_back();
+    free_.push_back(handle);
+}
+
+void ParticlePool::save(SnapshotWriter& out) const {
+    out.put<uint64_t>(trail_capacity_);
+    out.put_array(hot.x);
+    out.put_array(hot.y);
+    out.put_array(hot.vy);
+    out.put_array(cold);
+    out.put_array(free_);
+    out.put_array(live_);
+    out.put_array(live_index_);
+    out.put_array(trail_glyphs_);
+}
+
+bool ParticlePool::load(SnapshotReader& in) {
+    uint64_t trail_capacity = 0;
+    if (!in.get(trail_capacity) || trail_capacity == 0 || !in.get_array(hot.x) || !in.get_array(hot.y) ||
+        !in.get_array(hot.vy) || !in.get_array(cold) || !in.get_array(free_) || !in.get_array(live_) ||
+        !in.get_array(live_index_) || !in.get_array(trail_glyphs_)) {
+        return false;
+    }
+    trail_capacity_ = static_cast<std::size_t>(trail_capacity);
+    const std::size_t count = cold.size();
+    const auto valid = [count](Handle handle) { return handle < count; };
+    if (hot.x.size() != count || hot.y.size() != count || hot.vy.size() != count || live_index_.size() != count ||
+        trail_glyphs_.size() != count * trail_capacity_ || free_.size() + live_.size() != count ||
+        !std::all_of(free_.begin(), free_.end(), valid) || !std::all_of(live_.begin(), live_.end(), valid)) {
+        return false;
+    }
+    // Every handle is either free or live, exactly once, and a live one is
+    // found again through live_index_, which retire() writes through.
+    std::vector<bool> seen(count, false);
+    for (const Handle handle : free_) {
+        if (seen[handle]) {
+            return false;
+        }
+        seen[handle] = true;
+    }
+    for (std::size_t index = 0; index < live_.size(); ++index) {
+        const Handle handle = live_[index];
+        if (seen[handle] || live_index_[handle] != index) {
+            return false;
+        }
+        seen[handle] = true;
+    }
+    if (!std::all_of(cold.begin(), cold.end(), [&](const Cold& particle) { return particle.trailLength <= trail_capacity_; })) {
+        return false;
+    }
+    live_.reserve(count);
+    free_.reserve(count);
+    return true;
+}
+
+void ConvergeEmitter::emit(ParticlePool& pool, const std::vector<ConvergeTarget>& targets, const Settings& settings,
+                           const std::vector<char32_t>& charset, const AliasTable& weights, std::mt19937& rng) {
+    const int min_trail = std::max(1, std::min(settings.minTrail, settings.maxTrail));
+    const int max_trail = std::min(static_cast<int>(pool.trail_capacity()), std::max(min_trail, settings.maxTrail));
+    std::uniform_int_distribution<int> trail_dist(std::min(min_trail, max_trail), max_trail);
+    std::uniform_real_distribution<float> start_dist(-static_cast<float>(std::max(1U, settings.rows)), 0.0f);
+
+    const float randomness = std::clamp(settings.randomness, 0.0f, 1.0f);
+    std::uniform_real_distribution<float> multiplier_dist(std::max(0.1f, 1.0f - randomness), 1.0f + randomness);
+
+    const auto pending = [&](const ConvergeTarget& target) { return !target.landed && target.glyph != U' '; };
+
+    // Counting sort of the pending targets by column, then top to bottom
+    // within each column.
+    int max_column = -1;
+    for (const ConvergeTarget& target : targets) {
+        if (pending(target)) {
+            max_column = std::max(max_column, target.x);
+        }
+    }
+    if (max_column < 0) {
+        return;
+    }
+    column_start_.assign(static_cast<std::size_t>(max_column) + 2U, 0U);
+    for (const ConvergeTarget& target : targets) {
+        if (pending(target)) {
+            column_start_[static_cast<std::size_t>(target.x) + 1U]++;
+        }
+    }
+    std::size_t widest = 0;
+    for (std::size_t column = 1; column < column_start_.size(); ++column) {
+        widest = std::max<std::size_t>(widest, column_start_[column]);
+        column_start_[column] += column_start_[column - 1];
+    }
+    order_.resize(column_start_.back());
+    for (std::size_t i = 0; i < targets.size(); ++i) {
+        if (pending(targets[i])) {
+            order_[column_start_[static_cast<std::size_t>(targets[i].x)]++] = static_cast<uint32_t>(i);
+        }
+    }
+    // The fill pass advanced each start to the next column's start.
+    for (std::size_t column = column_start_.size() - 1; column > 0; --column) {
+        column_start_[column] = column_start_[column - 1];
+    }
+    column_start_[0] = 0;
+
+    arrivals_.resize(widest);
+    starts_.resize(widest);
+    for (std::size_t column = 0; column + 1 < column_start_.size(); ++column) {
+        const auto begin = order_.begin() + column_start_[column];
+        const auto end = order_.begin() + column_start_[column + 1];
+        const auto count = static_cast<std::size_t>(end - begin);
+        if (count == 0) {
+            continue;
+        }
+        std::sort(begin, end, [&](uint32_t a, uint32_t b) { return targets[a].y < targets[b].y; });
+
+        // Earliest arrival and lowest start go to the lowest target.
+        for (std::size_t i = 0; i < count; ++i) {
+            arrivals_[i] = settings.duration > 0.0f ? settings.duration / multiplier_dist(rng) : 0.0f;
+            starts_[i] = start_dist(rng);
+        }
+        std::sort(arrivals_.begin(), arrivals_.begin() + static_cast<std::ptrdiff_t>(count));
+        std::sort(starts_.begin(), starts_.begin() + static_cast<std::ptrdiff_t>(count), std::greater<>());
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const uint32_t index = *(end - 1 - static_cast<std::ptrdiff_t>(i));
+            const float start_y = starts_[i];
+            const float target_y = static_cast<float>(targets[index].y);
+            float speed = 1.0f;
+            if (arrivals_[i] > 0.0f && target_y > start_y) {
+                speed = (target_y - start_y) / arrivals_[i];
+            }
+            if (spawn(pool, targets, index, start_y, speed, trail_dist(rng), charset, weights, rng) == ParticlePool::kInvalidHandle) {
+                return;
+            }
+        }
+    }
+}
+
+ParticlePool::Handle ConvergeEmitter::emit_one(ParticlePool& pool, const std::vector<ConvergeTarget>& targets, uint32_t index,
+                                               const Settings& settings, const std::vector<char32_t>& charset,
+                                               const AliasTable& weights, std::mt19937& rng) {
+    const int min_trail = std::max(1, std::min(settings.minTrail, settings.maxTrail));
+    const int max_trail = std::min(static_cast<int>(pool.trail_capacity()), std::max(min_trail, settings.maxTrail));
+    std::uniform_int_distribution<int> trail_dist(std::min(min_trail, max_trail), max_trail);
+    std::uniform_real_distribution<float> start_dist(-static_cast<float>(std::max(1U, settings.rows)), 0.0f);
+    const float randomness = std::clamp(settings.randomness, 0.0f, 1.0f);
+    std::uniform_real_distribution<float> multiplier_dist(std::max(0.1f, 1.0f - randomness), 1.0f + randomness);
+
+    const float arrival = settings.duration > 0.0f ? settings.duration / multiplier_dist(rng) : 0.0f;
+    const float start_y = start_dist(rng);
+    const float target_y = static_cast<float>(targets[index].y);
+    float speed = 1.0f;
+    if (arrival > 0.0f && target_y > start_y) {
+        speed = (target_y - start_y) / arrival;
+    }
+    return spawn(pool, targets, index, start_y, speed, trail_dist(rng), charset, weights, rng);
+}
+
+ParticlePool::Handle ConvergeEmitter::spawn(ParticlePool& pool, const std::vector<ConvergeTarget>& targets, uint32_t index,
+                                            float start_y, float speed, int trail_length,
+                                            const std::vector<char32_t>& charset, const AliasTable& weights,
+                                            std::mt19937& rng) {
+    const ParticlePool::Handle handle = pool.spawn();
+    if (handle == ParticlePool::kInvalidHandle) {
+        return handle;
+    }
+    const ConvergeTarget& target = targets[index];
+    pool.hot.x[handle] = static_cast<float>(target.x);
+    pool.hot.y[handle] = start_y;
+    pool.hot.vy[handle] = speed;
+
+    auto& cold = pool.cold[handle];
+    cold.glyph = target.glyph;
+    cold.target = index;
+    cold.targetY = static_cast<float>(target.y);
+    cold.trailLength = static_cast<uint16_t>(std::clamp<int>(trail_length, 1, static_cast<int>(pool.trail_capacity())));
+    cold.state = ParticlePool::State::Converging;
+
+    char32_t* trail = pool.trail(handle);
+    trail[0] = target.glyph;
+    for (std::size_t t = 1; t < cold.trailLength; ++t) {
+        trail[t] = pick_glyph(charset, weights, rng);
+    }
+    return handle;
+}
+
+std::size_t ConvergeBehavior::update(ParticlePool& pool, std::vector<ConvergeTarget>& targets, float delta, float shimmer_chance,
+                                     const std::vector<char32_t>& charset, const AliasTable& weights,
+                                     std::mt19937& rng) const {
+    std::uniform_real_distribution<float> shimmer_dist(0.0f, 1.0f);
+    std::size_t landed = 0;
+
+    // Motion first, over the hot arrays only.
+    const auto& live = pool.live();
+    for (const ParticlePool::Handle handle : live) {
+        pool.hot.y[handle] += pool.hot.vy[handle] * delta;
+    }
+
+    for (std::size_t i = live.size(); i > 0; --i) {
+        const ParticlePool::Handle handle = live[i - 1];
+        auto& cold = pool.cold[handle];
+        float& y = pool.hot.y[handle];
+
+        if (cold.trailLength > 1 && shimmer_dist(rng) < shimmer_chance) {
+            std::uniform_int_distribution<std::size_t> index_dist(1, cold.trailLength - 1U);
+            pool.trail(handle)[index_dist(rng)] = pick_glyph(charset, weights, rng);
+        }
+
+        if (cold.state == ParticlePool::State::Converging) {
+            if (y >= cold.targetY) {
+                y = cold.targetY;
+                cold.state = ParticlePool::State::Absorbing;
+                targets[cold.target].landed = true;
+                landed++;
+            }
+            continue;
+        }
+
+        if (cold.state == ParticlePool::State::Dissolving && cold.trailLength < pool.trail_capacity()) {
+            cold.trailLength++;
+        }
+        const float tail_y = y - static_cast<float>(cold.trailLength - 1U);
+        if (tail_y >= cold.targetY) {
+            pool.retire(handle);
+        }
+    }
+    return landed;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "utils/AliasTable.h"
+#include "utils/SnapshotIo.h"
+
+// Fixed-capacity particle pool. Slots are handed out from a free list and the
+// live set is kept dense, so spawn, retire and iteration never allocate once
+// the pool has been sized. Per-frame motion data (hot) is stored apart from
+// data only needed on state changes or when drawing (cold).
+class ParticlePool {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle kInvalidHandle = 0xFFFFFFFFU;
+
+    // Dissolving particles are landed glyphs falling away as rain; their
+    // trail grows by one glyph per step and they retire below `targetY`.
+    enum class State : uint8_t { Converging, Absorbing, Dissolving };
+
+    struct Hot {
+        std::vector<float> x{};
+        std::vector<float> y{};
+        std::vector<float> vy{};
+    };
+
+    struct Cold {
+        char32_t glyph{U' '};
+        uint32_t target{0};
+        float targetY{0.0f};
+        uint16_t trailLength{0};
+        State state{State::Converging};
+    };
+
+    // Sizes the pool for `capacity` particles with up to `trail_capacity`
+    // trail glyphs each. This is the only call that allocates.
+    void reset(std::size_t capacity, std::size_t trail_capacity);
+    void clear();
+    // Raises the capacity to at least `capacity`, keeping live particles.
+    void grow(std::size_t capacity);
+
+    Handle spawn();
+    void retire(Handle handle);
+
+    std::size_t capacity() const { return cold.size(); }
+    // Gives the live and free lists room for `other`'s capacity, so copying
+    // `other` in later does not reallocate them.
+    void reserve_like(const ParticlePool& other);
+    std::size_t trail_capacity() const { return trail_capacity_; }
+    bool empty() const { return live_.empty(); }
+    // Dense list of live handles. Retiring swaps the last entry into the
+    // retired one's place, so iterate backwards when retiring in a loop.
+    const std::vector<Handle>& live() const { return live_; }
+
+    char32_t* trail(Handle handle) { return trail_glyphs_.data() + static_cast<std::size_t>(handle) * trail_capacity_; }
+    const char32_t* trail(Handle handle) const { return trail_glyphs_.data() + static_cast<std::size_t>(handle) * trail_capacity_; }
+
+    // Warm start. load() replaces the pool, live particles and free list
+    // included, and keeps room to spawn up to the capacity without allocating.
+    // It fails unless every handle is free or live exactly once and every
+    // trail fits the trail capacity.
+    void save(SnapshotWriter& out) const;
+    bool load(SnapshotReader& in);
+
+    Hot hot{};
+    std::vector<Cold> cold{};
+
+private:
+    std::vector<Handle> free_{};
+    std::vector<Handle> live_{};
+    std::vector<uint32_t> live_index_{};
+    std::vector<char32_t> trail_glyphs_{};
+    std::size_t trail_capacity_{0};
+};
+
+struct ConvergeTarget {
+    int x{0};
+    int y{0};
+    char32_t glyph{U' '};
+    bool landed{false};
+};
+
+// Spawns one glyph particle per target above the screen, with a speed chosen
+// so it lands after about `duration` seconds. Targets are bucketed by column;
+// within a column the lowest target gets the earliest arrival and the lowest
+// start, so particles sharing a column never pass each other.
+class ConvergeEmitter {
+public:
+    struct Settings {
+        float duration{5.0f};
+        float randomness{0.0f};
+        int minTrail{1};
+        int maxTrail{1};
+        unsigned int rows{0};
+    };
+
+    void emit(ParticlePool& pool, const std::vector<ConvergeTarget>& targets, const Settings& settings,
+              const std::vector<char32_t>& charset, const AliasTable& weights, std::mt19937& rng);
+
+    // Spawns a particle for `targets[index]` alone, timed like emit().
+    static ParticlePool::Handle emit_one(ParticlePool& pool, const std::vector<ConvergeTarget>& targets, uint32_t index,
+                                         const Settings& settings, const std::vector<char32_t>& charset,
+                                         const AliasTable& weights, std::mt19937& rng);
+
+    // Spawns a particle converging on `targets[index]` from `start_y` at
+    // `speed`, with `trail_length` glyphs behind the target glyph. Returns
+    // kInvalidHandle when the pool is full.
+    static ParticlePool::Handle spawn(ParticlePool& pool, const std::vector<ConvergeTarget>& targets, uint32_t index,
+                                      float start_y, float speed, int trail_length, const std::vector<char32_t>& charset,
+                                      const AliasTable& weights, std::mt19937& rng);
+
+private:
+    // Scratch space reused between calls.
+    std::vector<uint32_t> column_start_{};
+    std::vector<uint32_t> order_{};
+    std::vector<float> arrivals_{};
+    std::vector<float> starts_{};
+};
+
+// Moves converging particles onto their targets, then lets their trails flow
+// into the landed glyph before retiring them.
+class ConvergeBehavior {
+public:
+    // Returns the number of particles that landed during this step.
+    std::size_t update(ParticlePool& pool, std::vector<ConvergeTarget>& targets, float delta, float shimmer_chance,
+                       const std::vector<char32_t>& charset, const AliasTable& weights, std::mt19937& rng) const;
+};
@@ -0,0 +1,126 @@
+#include "effects/PhosphorBuffer.h"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+#if defined(__SSE2__)
+// value * intensity / 255 on eight 16-bit lanes.
+inline __m128i scale_epi16(__m128i intensity, __m128i value) {
+    const __m128i product = _mm_mullo_epi16(intensity, value);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), _mm_set1_epi16(1)), 8);
+}
+
+inline __m128i scale_epi8(__m128i intensity, __m128i value) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = scale_epi16(_mm_unpacklo_epi8(intensity, zero), value);
+    const __m128i hi = scale_epi16(_mm_unpackhi_epi8(intensity, zero), value);
+    return _mm_packus_epi16(lo, hi);
+}
+#endif
+} // namespace
+
+void PhosphorBuffer::resize(unsigned int rows, unsigned int cols) {
+    surface_.resize(rows, cols);
+    intensity_.assign(surface_.size(), 0);
+    clear();
+}
+
+void PhosphorBuffer::clear() {
+    std::fill(intensity_.begin(), intensity_.end(), uint8_t{0});
+    std::fill(surface_.styles.begin(), surface_.styles.end(), uint8_t{0});
+    surface_.clear();
+}
+
+void PhosphorBuffer::decay(uint8_t amount) {
+    if (amount == 0) {
+        return;
+    }
+    const std::size_t cells = intensity_.size();
+    uint8_t* data = intensity_.data();
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i step = _mm_set1_epi8(static_cast<char>(amount));
+    for (; i + 16 <= cells; i += 16) {
+        const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_subs_epu8(value, step));
+    }
+#endif
+    for (; i < cells; ++i) {
+        data[i] = data[i] > amount ? static_cast<uint8_t>(data[i] - amount) : uint8_t{0};
+    }
+}
+
+void PhosphorBuffer::shade(color::Rgb tail, uint8_t alpha, int fade_levels) {
+    const std::size_t cells = intensity_.size();
+    std::size_t i = 0;
+    if (fade_levels > 0) {
+        // Few distinct levels: look the colors up per intensity.
+        std::array<color::Rgb, 256> levels{};
+        for (std::size_t level = 0; level < levels.size(); ++level) {
+            levels[level] = color::scale(tail, color::quantize(static_cast<float>(level) / 255.0f, fade_levels));
+        }
+        for (; i < cells; ++i) {
+            const color::Rgb& shade = levels[intensity_[i]];
+            surface_.r[i] = shade.r;
+            surface_.g[i] = shade.g;
+            surface_.b[i] = shade.b;
+            surface_.alpha[i] = intensity_[i] != 0 ? alpha : uint8_t{0};
+        }
+        return;
+    }
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i red = _mm_set1_epi16(tail.r);
+    const __m128i green = _mm_set1_epi16(tail.g);
+    const __m128i blue = _mm_set1_epi16(tail.b);
+    const __m128i lit_alpha = _mm_set1_epi8(static_cast<char>(alpha));
+    for (; i + 16 <= cells; i += 16) {
+        const __m128i intensity = _mm_loadu_si128(reinterpret_cast<const __m128i*>(intensity_.data() + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(surface_.r.data() + i), scale_epi8(intensity, red));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(surface_.g.data() + i), scale_epi8(intensity, green));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(surface_.b.data() + i), scale_epi8(intensity, blue));
+        const __m128i dark = _mm_cmpeq_epi8(intensity, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(surface_.alpha.data() + i), _mm_andnot_si128(dark, lit_alpha));
+    }
+#endif
+    for (; i < cells; ++i) {
+        const unsigned intensity = intensity_[i];
+        const auto scale = [&](uint8_t value) {
+            const unsigned product = intensity * value;
+            return static_cast<uint8_t>((product + (product >> 8U) + 1U) >> 8U);
+        };
+        surface_.r[i] = scale(tail.r);
+        surface_.g[i] = scale(tail.g);
+        surface_.b[i] = scale(tail.b);
+        surface_.alpha[i] = intensity != 0 ? alpha : uint8_t{0};
+    }
+}
+
+std::size_t PhosphorBuffer::footprint() const {
+    // Glyphs, five color/alpha/style planes, glow and intensity per cell.
+    return surface_.glyphs.capacity() * sizeof(char32_t) + surface_.r.capacity() * 6 + intensity_.capacity();
+}
+
+void PhosphorBuffer::save(SnapshotWriter& out) const {
+    // Colors are shaded from the intensities every frame.
+    out.put(surface_.rows);
+    out.put(surface_.cols);
+    out.put_array(surface_.glyphs);
+    out.put_array(intensity_);
+}
+
+bool PhosphorBuffer::load(SnapshotReader& in) {
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+    if (!in.get(rows) || !in.get(cols) || static_cast<std::size_t>(rows) * cols > in.remaining()) {
+        return false;
+    }
+    resize(rows, cols);
+    return in.get_exact(std::span<char32_t>(surface_.glyphs)) && in.get_exact(std::span<uint8_t>(intensity_));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "engine/Framebuffer.h"
+#include "utils/Color.h"
+#include "utils/SnapshotIo.h"
+
+// Persistent glow for phosphor-style rain. Each cell keeps the glyph that was
+// last written to it and an intensity that decays a little every frame, so a
+// stream only has to light the cells its head enters instead of redrawing its
+// whole trail. The cells are kept in a Framebuffer that is recorded with
+// DrawList::surface().
+class PhosphorBuffer {
+public:
+    // Sizes the buffer for the screen and clears it. Allocates.
+    void resize(unsigned int rows, unsigned int cols);
+    void clear();
+
+    unsigned int rows() const { return surface_.rows; }
+    unsigned int cols() const { return surface_.cols; }
+
+    // Lights a cell at full intensity with `glyph`.
+    void excite(unsigned int y, unsigned int x, char32_t glyph) {
+        const std::size_t cell = surface_.index(y, x);
+        surface_.glyphs[cell] = glyph;
+        intensity_[cell] = 255;
+    }
+    // Swaps the glyph of a cell that is still lit.
+    void shimmer(unsigned int y, unsigned int x, char32_t glyph) {
+        const std::size_t cell = surface_.index(y, x);
+        if (intensity_[cell] != 0) {
+            surface_.glyphs[cell] = glyph;
+        }
+    }
+
+    // Dims every cell by `amount` out of 255.
+    void decay(uint8_t amount);
+    // Colors the cells from their intensity: `tail` at full intensity, and
+    // `alpha` for every lit cell. With `fade_levels` > 0 the intensity is
+    // snapped to that many steps first.
+    void shade(color::Rgb tail, uint8_t alpha, int fade_levels);
+
+    const Framebuffer& surface() const { return surface_; }
+    std::size_t footprint() const;
+
+    // Warm start: the glyphs and intensities. load() resizes the buffer.
+    void save(SnapshotWriter& out) const;
+    bool load(SnapshotReader& in);
+
+private:
+    Framebuffer surface_{};
+    std::vector<uint8_t> intensity_{};
+};
@@ -0,0 +1,271 @@
+#include "PixelRainEffect.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <type_traits>
+
+#include "effects/TrailKernel.h"
+#include "utils/Color.h"
+
+namespace {
+constexpr float kDefaultFrameTime = 1.0f / 60.0f;
+
+std::mt19937& resolve_rng(const Context& context, std::mt19937& fallback) {
+    if (context.rng != nullptr) {
+        return *context.rng;
+    }
+    return fallback;
+}
+
+// ncvisual_from_rgba expects bytes in R, G, B, A order.
+constexpr uint32_t pack_rgba(color::Rgb color) {
+    if constexpr (std::endian::native == std::endian::little) {
+        return 0xFF000000U | (static_cast<uint32_t>(color.b) << 16U) | (static_cast<uint32_t>(color.g) << 8U) | color.r;
+    } else {
+        return (static_cast<uint32_t>(color.r) << 24U) | (static_cast<uint32_t>(color.g) << 16U) |
+               (static_cast<uint32_t>(color.b) << 8U) | 0xFFU;
+    }
+}
+} // namespace
+
+PixelRainEffect::PixelRainEffect(PixelRainConfig config)
+    : config_(std::move(config)),
+      fallback_rng_(std::random_device{}()),
+      start_time_(std::chrono::steady_clock::now()) {
+    const float radians = config_.rainConfig.slantAngle * std::numbers::pi_v<float> / 180.0f;
+    x_velocity_per_unit_y_ = std::tan(radians);
+}
+
+PixelRainEffect::~PixelRainEffect() {
+    if (plane_ != nullptr) {
+        ncplane_destroy(plane_);
+    }
+}
+
+void PixelRainEffect::select_blitter(const Context& context) {
+    blitter_selected_ = true;
+    PixelBlitter wanted = config_.blitter;
+    if (context.nc == nullptr) {
+        wanted = wanted == PixelBlitter::Pixel ? PixelBlitter::Sextant : wanted;
+    }
+
+    // Fall back one step at a time to what the terminal can actually draw.
+    if (wanted == PixelBlitter::Pixel) {
+        if (notcurses_check_pixel_support(context.nc) != NCPIXEL_NONE) {
+            ncvisual_options vopts{};
+            vopts.blitter = NCBLIT_PIXEL;
+            ncvgeom geom{};
+            if (ncvisual_geom(context.nc, nullptr, &vopts, &geom) == 0 && geom.cdimy > 0 && geom.cdimx > 0) {
+                blitter_ = NCBLIT_PIXEL;
+                scale_y_ = geom.cdimy;
+                scale_x_ = geom.cdimx;
+                return;
+            }
+        }
+        wanted = PixelBlitter::Sextant;
+    }
+    if (wanted == PixelBlitter::Braille && (context.nc == nullptr || notcurses_canbraille(context.nc))) {
+        blitter_ = NCBLIT_BRAILLE;
+        scale_y_ = 4;
+        scale_x_ = 2;
+        return;
+    }
+    if (wanted == PixelBlitter::Sextant && (context.nc == nullptr || notcurses_cansextant(context.nc))) {
+        blitter_ = NCBLIT_3x2;
+        scale_y_ = 3;
+        scale_x_ = 2;
+        return;
+    }
+    if (context.nc == nullptr || notcurses_canquadrant(context.nc)) {
+        blitter_ = NCBLIT_2x2;
+        scale_y_ = 2;
+        scale_x_ = 2;
+        return;
+    }
+    blitter_ = NCBLIT_2x1;
+    scale_y_ = 2;
+    scale_x_ = 1;
+}
+
+bool PixelRainEffect::ensure_plane(const Context& context) {
+    if (context.root_plane == nullptr) {
+        return false;
+    }
+    if (plane_ == nullptr) {
+        ncplane_options options{};
+        options.rows = context.rows;
+        options.cols = context.cols;
+        options.name = "pixel-rain";
+        plane_ = ncplane_create(context.root_plane, &options);
+        return plane_ != nullptr;
+    }
+    return ncplane_resize_simple(plane_, context.rows, context.cols) == 0;
+}
+
+void PixelRainEffect::ensure_initialized(const Context& context) {
+    if (context.cols == 0 || context.rows == 0) {
+        return;
+    }
+    if (!blitter_selected_) {
+        select_blitter(context);
+    }
+    if (context.rows == cached_rows_ && context.cols == cached_cols_) {
+        return;
+    }
+
+    ensure_plane(context);
+    cached_rows_ = context.rows;
+    cached_cols_ = context.cols;
+    pixel_rows_ = context.rows * scale_y_;
+    pixel_cols_ = context.cols * scale_x_;
+    pixels_.assign(static_cast<std::size_t>(pixel_rows_) * pixel_cols_, 0U);
+
+    const auto desired_streams = std::max<std::size_t>(1, static_cast<std::size_t>(static_cast<float>(pixel_cols_) * config_.rainConfig.density));
+    streams_.assign(desired_streams, PixelStream{});
+}
+
+std::size_t PixelRainEffect::active_stream_count(const Context& context) const {
+    const float scale = std::clamp(context.quality.density, 0.0f, 1.0f);
+    const auto active = static_cast<std::size_t>(std::ceil(static_cast<float>(streams_.size()) * scale));
+    return std::clamp<std::size_t>(active, 1, streams_.size());
+}
+
+void PixelRainEffect::reset_stream(PixelStream& stream, std::mt19937& rng) const {
+    const RainConfig& rain = config_.rainConfig;
+    const float min_speed = std::min(rain.minSpeed, rain.maxSpeed);
+    const float max_speed = std::max(rain.minSpeed, rain.maxSpeed);
+    std::uniform_real_distribution<float> speed_dist(min_speed, max_speed);
+
+    const int min_length = std::max(1, std::min(rain.minLength, rain.maxLength));
+    const int max_length = std::max(min_length, rain.maxLength);
+    std::uniform_int_distribution<int> length_dist(min_length, max_length);
+
+    std::uniform_real_distribution<float> x_dist(0.0f, static_cast<float>(pixel_cols_ - 1U));
+    std::uniform_real_distribution<float> y_dist(-static_cast<float>(pixel_rows_), 0.0f);
+
+    stream.x = x_dist(rng);
+    stream.y = y_dist(rng);
+    stream.speed = speed_dist(rng) * static_cast<float>(scale_y_);
+    stream.length = length_dist(rng) * static_cast<int>(scale_y_);
+    stream.markedForReset = false;
+}
+
+void PixelRainEffect::update(const Context& context) {
+    ensure_initialized(context);
+    if (streams_.empty() || pixel_cols_ == 0) {
+        return;
+    }
+
+    const float delta = (context.deltaTime > 0.0f) ? context.deltaTime : kDefaultFrameTime;
+    std::mt19937& rng = resolve_rng(context, fallback_rng_);
+    const float cols_f = static_cast<float>(pixel_cols_);
+    const float rows_f = static_cast<float>(pixel_rows_);
+
+    const std::size_t active_streams = active_stream_count(context);
+    for (std::size_t i = 0; i < streams_.size(); ++i) {
+        PixelStream& stream = streams_[i];
+        if (stream.markedForReset) {
+            if (i < active_streams) {
+                reset_stream(stream, rng);
+            }
+            continue;
+        }
+
+        stream.y += stream.speed * delta;
+        stream.x += stream.speed * x_velocity_per_unit_y_ * delta;
+        while (stream.x < 0.0f) {
+            stream.x += cols_f;
+        }
+        while (stream.x >= cols_f) {
+            stream.x -= cols_f;
+        }
+
+        if (stream.y - static_cast<float>(stream.length) > rows_f) {
+            stream.markedForReset = true;
+        }
+    }
+}
+
+void PixelRainEffect::rasterize(const Context& context) {
+    std::fill(pixels_.begin(), pixels_.end(), 0U);
+
+    const uint32_t lead = pack_rgba(color::decode_rgba(config_.rainConfig.leadCharColor));
+    const color::Rgb tail = color::decode_rgba(config_.rainConfig.tailColor);
+    const float trail_scale = std::clamp(context.quality.trailLength, 0.0f, 1.0f);
+    const int rows = static_cast<int>(pixel_rows_);
+    const int cols = static_cast<int>(pixel_cols_);
+
+    // One loop per frame for slanted or vertical rain; vertical trails find
+    // their column once.
+    const auto draw_streams = [&](auto slanted) {
+        constexpr bool kSlanted = decltype(slanted)::value;
+        for (const PixelStream& stream : streams_) {
+            if (stream.markedForReset) {
+                continue;
+            }
+            const int drawn_length = std::max(1, static_cast<int>(std::ceil(static_cast<float>(stream.length) * trail_scale)));
+            const int head_y = static_cast<int>(std::floor(stream.y));
+            // Only the part of the trail that is on screen is visited.
+            const int first = std::max(0, head_y - rows + 1);
+            const int last = std::min(drawn_length, head_y + 1);
+            int x = static_cast<int>(std::round(stream.x));
+            if constexpr (!kSlanted) {
+                trail_kernel::wrap_column(x, cols);
+            }
+            for (int i = first; i < last; ++i) {
+                if constexpr (kSlanted) {
+                    x = static_cast<int>(std::round(stream.x - static_cast<float>(i) * x_velocity_per_unit_y_));
+                    trail_kernel::wrap_column(x, cols);
+                }
+
+                uint32_t pixel = lead;
+                if (i > 0) {
+                    const float t = static_cast<float>(i) / static_cast<float>(std::max(1, drawn_length - 1));
+                    pixel = pack_rgba(color::scale(tail, color::quantize(1.0f - t, context.output.fadeLevels)));
+                }
+                pixels_[static_cast<std::size_t>(head_y - i) * pixel_cols_ + static_cast<std::size_t>(x)] = pixel;
+            }
+        }
+    };
+    if (x_velocity_per_unit_y_ != 0.0f) {
+        draw_streams(std::true_type{});
+    } else {
+        draw_streams(std::false_type{});
+    }
+}
+
+void PixelRainEffect::render(const Context& context) {
+    ensure_initialized(context);
+    if (plane_ == nullptr || pixels_.empty()) {
+        return;
+    }
+
+    rasterize(context);
+
+    // One bulk upload per frame: the buffer becomes a visual, is blitted onto
+    // our plane, and is released again.
+    struct ncvisual* visual = ncvisual_from_rgba(pixels_.data(), static_cast<int>(pixel_rows_),
+                                                 static_cast<int>(pixel_cols_ * sizeof(uint32_t)), static_cast<int>(pixel_cols_));
+    if (visual == nullptr) {
+        return;
+    }
+    ncvisual_options vopts{};
+    vopts.n = plane_;
+    vopts.scaling = NCSCALE_NONE;
+    vopts.blitter = blitter_;
+    ncplane_erase(plane_);
+    ncvisual_blit(context.nc, visual, &vopts);
+    ncvisual_destroy(visual);
+}
+
+bool PixelRainEffect::isFinished() const {
+    if (config_.rainConfig.duration <= 0.0f) {
+        return false;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const float elapsed = std::chrono::duration<float>(now - start_time_).count();
+    return elapsed >= config_.rainConfig.duration;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "effects/RainEffect.h"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <notcurses/notcurses.h>
+
+enum class PixelBlitter {
+    Quadrant, // 2x2 per cell
+    Sextant,  // 3x2 per cell
+    Braille,  // 4x2 per cell, monochrome within a cell
+    Pixel,    // terminal bitmap graphics (sixel, kitty)
+};
+
+struct PixelRainConfig {
+    // Speeds and lengths are in cells, as for the glyph rain; density is the
+    // fraction of sub-cell columns that carry a stream. The character set is
+    // not used.
+    RainConfig rainConfig{};
+    PixelBlitter blitter{PixelBlitter::Sextant};
+};
+
+// Rain drawn as colored pixels at sub-cell resolution. The whole frame is
+// rendered into an RGBA buffer and handed to notcurses with one ncvisual_blit
+// onto the effect's own plane, instead of one putegc call per glyph.
+class PixelRainEffect : public Effect {
+public:
+    explicit PixelRainEffect(PixelRainConfig config);
+    ~PixelRainEffect() override;
+
+    PixelRainEffect(const PixelRainEffect&) = delete;
+    PixelRainEffect& operator=(const PixelRainEffect&) = delete;
+
+    void update(const Context& context) override;
+    void render(const Context& context) override;
+    bool isFinished() const override;
+    Footprint footprint() const override { return Footprint{streams_.size(), streams_.capacity() * sizeof(PixelStream)}; }
+
+private:
+    struct PixelStream {
+        float x{0.0f};
+        float y{0.0f};
+        float speed{0.0f};
+        int length{0};
+        bool markedForReset{true};
+    };
+
+    void ensure_initialized(const Context& context);
+    void select_blitter(const Context& context);
+    bool ensure_plane(const Context& context);
+    std::size_t active_stream_count(const Context& context) const;
+    void reset_stream(PixelStream& stream, std::mt19937& rng) const;
+    void rasterize(const Context& context);
+
+    PixelRainConfig config_;
+    std::vector<PixelStream> streams_{};
+    // Packed RGBA, `pixel_rows_` x `pixel_cols_`, rebuilt every frame.
+    std::vector<uint32_t> pixels_{};
+    struct ncplane* plane_{nullptr};
+    ncblitter_e blitter_{NCBLIT_2x1};
+    unsigned int scale_y_{2};
+    unsigned int scale_x_{1};
+    unsigned int cached_rows_{0};
+    unsigned int cached_cols_{0};
+    unsigned int pixel_rows_{0};
+    unsigned int pixel_cols_{0};
+    bool blitter_selected_{false};
+    // Used only when the Context provides no engine RNG.
+    std::mt19937 fallback_rng_{};
+    float x_velocity_per_unit_y_{0.0f};
+    std::chrono::steady_clock::time_point start_time_{};
+};
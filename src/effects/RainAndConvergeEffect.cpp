@@ -2,8 +2,6 @@
 
 #include <algorithm>
 #include <cmath>
-#include <fstream>
-#include <iterator>
 #include <limits>
 #include <numbers>
 #include <random>
@@ -11,10 +9,15 @@
 
 #include <notcurses/notcurses.h>
 
+#include "effects/TrailKernel.h"
+#include "utils/Color.h"
+#include "utils/SnapshotIo.h"
 #include "utils/Utf8.h"
 
 namespace {
 constexpr float kDefaultFrameTime = 1.0f / 60.0f;
+// How far, in columns, a new title glyph looks for a stream to take over.
+constexpr float kHandoverReach = 2.0f;
 std::mt19937& resolve_rng(const Context& context, std::mt19937& fallback) {
     if (context.rng != nullptr) {
         return *context.rng;
@@ -22,82 +25,22 @@ std::mt19937& resolve_rng(const Context& context, std::mt19937& fallback) {
     return fallback;
 }
 
-void decode_rgba(uint32_t color, uint8_t& r, uint8_t& g, uint8_t& b) {
-    r = static_cast<uint8_t>((color >> 24U) & 0xFFU);
-    g = static_cast<uint8_t>((color >> 16U) & 0xFFU);
-    b = static_cast<uint8_t>((color >> 8U) & 0xFFU);
-}
-
 } // namespace
 
 RainAndConvergeEffect::RainAndConvergeEffect(RainAndConvergeConfig config)
-    : config_(std::move(config)) {
+    : config_(std::move(config)),
+      fallback_rng_(std::random_device{}()) {
     const float radians = config_.rainConfig.slantAngle * std::numbers::pi_v<float> / 180.0f;
     x_velocity_per_unit_y_ = std::tan(radians);
-    ensure_character_set_loaded();
-}
-
-void RainAndConvergeEffect::ensure_character_set_loaded() {
-    if (!config_.rainConfig.characterSet.empty()) {
-        return;
-    }
-
-    std::ifstream input(config_.rainConfig.characterSetFile, std::ios::binary);
-    if (input.is_open()) {
-        std::string line;
-        while (std::getline(input, line)) {
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
-            }
-            const auto decoded = utf8::decode(line);
-            config_.rainConfig.characterSet.insert(config_.rainConfig.characterSet.end(), decoded.begin(), decoded.end());
-        }
-    }
-
-    if (config_.rainConfig.characterSet.empty()) {
-        static constexpr char32_t fallback_chars[] = {
-            U'0', U'1', U'2', U'3', U'4', U'5', U'6', U'7', U'8', U'9',
-            U'A', U'B', U'C', U'D', U'E', U'F', U'G', U'H', U'I', U'J',
-            U'K', U'L', U'M', U'N', U'O', U'P', U'Q', U'R', U'S', U'T',
-            U'U', U'V', U'W', U'X', U'Y', U'Z',
-            U'a', U'b', U'c', U'd', U'e', U'f', U'g', U'h', U'i', U'j',
-            U'k', U'l', U'm', U'n', U'o', U'p', U'q', U'r', U's', U't',
-            U'u', U'v', U'w', U'x', U'y', U'z',
-            U'@', U'#', U'$', U'%', U'&', U'*'
-        };
-        config_.rainConfig.characterSet.assign(std::begin(fallback_chars), std::end(fallback_chars));
+    glyphs_ = share_glyph_set(config_.rainConfig);
+    if (config_.title.empty() && !config_.titleQueue.empty()) {
+        config_.title = config_.titleQueue.front();
+        next_title_ = 1;
     }
 }
 
-char32_t RainAndConvergeEffect::random_character(std::mt19937& rng) const {
-    if (config_.rainConfig.characterSet.empty()) {
-        return U' ';
-    }
-
-    std::uniform_int_distribution<std::size_t> dist(0, config_.rainConfig.characterSet.size() - 1);
-    return config_.rainConfig.characterSet[dist(rng)];
-}
-
-std::string RainAndConvergeEffect::encode_utf8(char32_t codepoint) {
-    std::string out;
-    if (codepoint <= 0x7FU) {
-        out.push_back(static_cast<char>(codepoint));
-    } else if (codepoint <= 0x7FFU) {
-        out.push_back(static_cast<char>(0xC0U | ((codepoint >> 6U) & 0x1FU)));
-        out.push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
-    } else if (codepoint <= 0xFFFFU) {
-        out.push_back(static_cast<char>(0xE0U | ((codepoint >> 12U) & 0x0FU)));
-        out.push_back(static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU)));
-        out.push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
-    } else if (codepoint <= 0x10FFFFU) {
-        out.push_back(static_cast<char>(0xF0U | ((codepoint >> 18U) & 0x07U)));
-        out.push_back(static_cast<char>(0x80U | ((codepoint >> 12U) & 0x3FU)));
-        out.push_back(static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU)));
-        out.push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
-    } else {
-        out.push_back('?');
-    }
-    return out;
+void RainAndConvergeEffect::set_title(std::u32string title) {
+    pending_title_ = std::move(title);
 }
 
 void RainAndConvergeEffect::ensure_initialized(const Context& context) {
@@ -114,93 +57,309 @@ void RainAndConvergeEffect::ensure_initialized(const Context& context) {
 }
 
 void RainAndConvergeEffect::initialize_streams(const Context& context) {
-    std::mt19937 fallback_rng{std::random_device{}()};
-    std::mt19937& rng = resolve_rng(context, fallback_rng);
+    std::mt19937& rng = resolve_rng(context, fallback_rng_);
 
-    streams_.assign(context.cols, {});
-    targeted_streams_ = 0;
+    const int max_length = std::max(1, std::max(config_.rainConfig.minLength, config_.rainConfig.maxLength));
+    streams_.reset(context.cols, static_cast<std::size_t>(max_length), glyphs_->glyphs.size());
+    landed_targets_ = 0;
     has_rendered_post_drain_ = false;
     all_in_place_ = false;
     draining_rain_ = false;
     rain_drained_ = false;
 
+    // Sized for every column up front so the lists never grow mid-run.
+    falling_.clear();
+    parked_.clear();
+    falling_.reserve(context.cols);
+    parked_.reserve(context.cols);
+    next_falling_.reserve(context.cols);
+    next_parked_.reserve(context.cols);
     for (unsigned int col = 0; col < context.cols; ++col) {
-        auto& stream = streams_[col];
-        stream.x = static_cast<float>(col);
-        stream.hasLeadChar = true;
-        reset_stream(stream, context, rng);
+        streams_[col].x = static_cast<float>(col);
+        reset_stream(col, context, rng);
+        falling_.push_back(col);
     }
+    live_streams_ = context.cols;
 
-    assign_title_streams(context, rng);
+    assign_title_targets(context, rng);
 }
 
-void RainAndConvergeEffect::assign_title_streams(const Context& context, std::mt19937& rng) {
-    if (config_.title.empty() || streams_.empty()) {
-        targeted_streams_ = 0;
+bool RainAndConvergeEffect::assign_mask_targets(const Context& context, std::mt19937& rng) {
+    ConvergeMask mask;
+    if (!load_converge_mask(config_.maskFile, context.rows, context.cols, glyphs_->glyphs, glyphs_->table, rng, mask)) {
+        return false;
+    }
+
+    // Center the mask horizontally, and vertically on titleRow when it is set.
+    const int rows = static_cast<int>(context.rows);
+    const int cols = static_cast<int>(context.cols);
+    const int mask_rows = static_cast<int>(mask.rows);
+    const int mask_cols = static_cast<int>(mask.cols);
+    const int center_row = (config_.titleRow > 0 && config_.titleRow < context.rows) ? static_cast<int>(config_.titleRow) : rows / 2;
+    const int top = std::clamp(center_row - mask_rows / 2, 0, std::max(0, rows - mask_rows));
+    const int left = std::max(0, (cols - mask_cols) / 2);
+
+    for (int y = 0; y < mask_rows && top + y < rows; ++y) {
+        for (int x = 0; x < mask_cols && left + x < cols; ++x) {
+            const char32_t glyph = mask.cells[static_cast<std::size_t>(y) * mask.cols + static_cast<std::size_t>(x)];
+            if (glyph != U'\0') {
+                targets_.push_back(ConvergeTarget{left + x, top + y, glyph, false});
+            }
+        }
+    }
+    return true;
+}
+
+unsigned int RainAndConvergeEffect::title_left(const Context& context, std::size_t width) const {
+    return context.cols > width ? (context.cols - static_cast<unsigned int>(width)) / 2 : 0;
+}
+
+unsigned int RainAndConvergeEffect::title_row(const Context& context) const {
+    return (config_.titleRow > 0 && config_.titleRow < context.rows) ? config_.titleRow : context.rows / 2;
+}
+
+ConvergeEmitter::Settings RainAndConvergeEffect::emitter_settings(const Context& context) const {
+    ConvergeEmitter::Settings settings{};
+    settings.duration = config_.convergenceDuration;
+    settings.randomness = config_.convergenceRandomness;
+    settings.minTrail = config_.rainConfig.minLength;
+    settings.maxTrail = config_.rainConfig.maxLength;
+    settings.rows = context.rows;
+    return settings;
+}
+
+void RainAndConvergeEffect::assign_title_targets(const Context& context, std::mt19937& rng) {
+    targets_.clear();
+    free_slots_.clear();
+    title_slots_.clear();
+    has_mask_ = !config_.maskFile.empty() && assign_mask_targets(context, rng);
+    if (!has_mask_) {
+        title_slots_.assign(context.cols, kNoSlot);
+    }
+    const std::size_t trail_capacity = static_cast<std::size_t>(std::max(1, config_.rainConfig.maxLength));
+    if (!has_mask_ && config_.title.empty()) {
+        active_targets_ = 0;
+        particles_.reset(0, trail_capacity);
         return;
     }
 
-    const unsigned int title_width = static_cast<unsigned int>(config_.title.size());
-    unsigned int start_col = 0;
-    if (context.cols > title_width) {
-        start_col = (context.cols - title_width) / 2;
+    std::size_t particle_capacity = 0;
+    if (!has_mask_) {
+        const unsigned int title_width = static_cast<unsigned int>(config_.title.size());
+        const unsigned int start_col = title_left(context, title_width);
+        const unsigned int target_row = title_row(context);
+
+        for (unsigned int i = 0; i < title_width; ++i) {
+            const char32_t glyph = config_.title[i];
+            if (glyph == U' ') {
+                continue;
+            }
+            const unsigned int column = std::min(context.cols - 1, start_col + i);
+            title_slots_[column] = static_cast<uint32_t>(targets_.size());
+            targets_.push_back(ConvergeTarget{static_cast<int>(column), static_cast<int>(target_row), glyph, false});
+        }
+
+        // While a title changes, a cell can have a glyph dissolving, one
+        // converging and the old trail still absorbing.
+        particle_capacity = 3 * reserve_title_queue(context.cols);
     }
+    active_targets_ = targets_.size();
 
-    const unsigned int target_row = (config_.titleRow > 0 && config_.titleRow < context.rows)
-        ? config_.titleRow
-        : context.rows / 2;
+    particles_.reset(std::max(particle_capacity, targets_.size()), trail_capacity);
+    emitter_.emit(particles_, targets_, emitter_settings(context), glyphs_->glyphs, glyphs_->table, rng);
+}
 
-    for (unsigned int i = 0; i < title_width; ++i) {
-        const char32_t glyph = config_.title[i];
-        const unsigned int column = std::min(context.cols - 1, start_col + i);
-        if (glyph == U' ') {
+void RainAndConvergeEffect::morph_title(const Context& context, const std::u32string& title, std::mt19937& rng) {
+    const std::size_t old_left = title_left(context, config_.title.size());
+    const std::size_t new_left = title_left(context, title.size());
+    const std::size_t begin = std::min(old_left, new_left);
+    const std::size_t end = std::min<std::size_t>(context.cols, std::max(old_left + config_.title.size(), new_left + title.size()));
+    const int target_row = static_cast<int>(title_row(context));
+
+    // The particle still converging on each slot, so a cell that changes
+    // mid-flight can be handed the new glyph instead.
+    slot_particles_.assign(targets_.size(), ParticlePool::kInvalidHandle);
+    for (const ParticlePool::Handle handle : particles_.live()) {
+        if (particles_.cold[handle].state == ParticlePool::State::Converging) {
+            slot_particles_[particles_.cold[handle].target] = handle;
+        }
+    }
+
+    // Only the columns either title covers are visited.
+    for (std::size_t column = begin; column < end; ++column) {
+        const char32_t glyph = (column >= new_left && column - new_left < title.size()) ? title[column - new_left] : U' ';
+        uint32_t slot = title_slots_[column];
+        if (slot == kNoSlot) {
+            if (glyph == U' ') {
+                continue;
+            }
+            if (free_slots_.empty()) {
+                slot = static_cast<uint32_t>(targets_.size());
+                targets_.emplace_back();
+            } else {
+                slot = free_slots_.back();
+                free_slots_.pop_back();
+            }
+            targets_[slot] = ConvergeTarget{static_cast<int>(column), target_row, glyph, false};
+            title_slots_[column] = slot;
+            active_targets_++;
+            spawn_title_particle(context, slot, rng);
             continue;
         }
 
-        if (column >= streams_.size()) {
+        ConvergeTarget& target = targets_[slot];
+        if (target.glyph == glyph) {
+            continue;
+        }
+        const ParticlePool::Handle incoming = slot_particles_[slot];
+        if (target.landed) {
+            dissolve_title_glyph(context, slot, rng);
+            target.landed = false;
+            landed_targets_--;
+        } else if (incoming != ParticlePool::kInvalidHandle && glyph != U' ') {
+            // Still falling: it lands with the new glyph.
+            particles_.cold[incoming].glyph = glyph;
+            particles_.trail(incoming)[0] = glyph;
+            target.glyph = glyph;
             continue;
+        } else if (incoming != ParticlePool::kInvalidHandle) {
+            // Still falling onto a cell that is going away: it falls on
+            // through as rain.
+            particles_.cold[incoming].state = ParticlePool::State::Dissolving;
+            particles_.cold[incoming].targetY = static_cast<float>(context.rows);
         }
 
-        auto& stream = streams_[column];
-        stream.isTitleStream = true;
-        stream.state = ExtendedRainStream::State::CONVERGING;
-        stream.titleChar = glyph;
-        stream.targetY = static_cast<float>(target_row);
-        stream.convergenceElapsed = 0.0f;
-        stream.allowRespawn = false;
-        stream.inactive = false;
-        stream.characters.resize(std::max(stream.maxLength, 1));
-        if (!stream.characters.empty()) {
-            stream.characters[0] = glyph;
+        if (glyph == U' ') {
+            target.glyph = U' ';
+            title_slots_[column] = kNoSlot;
+            free_slots_.push_back(slot);
+            active_targets_--;
+            continue;
+        }
+        target.glyph = glyph;
+        spawn_title_particle(context, slot, rng);
+    }
+
+    config_.title = title;
+    all_in_place_ = false;
+    rain_drained_ = false;
+    has_rendered_post_drain_ = false;
+    hold_elapsed_ = 0.0f;
+}
+
+std::size_t RainAndConvergeEffect::reserve_title_queue(unsigned int cols) {
+    // Room for the queued titles up front, so title changes never allocate.
+    // A change claims the slots of new columns before it frees the old ones,
+    // so the slot arrays can grow by every queued title, up to one per column.
+    std::size_t widest = 0;
+    std::size_t total = 0;
+    for (std::size_t i = next_title_; i < config_.titleQueue.size(); ++i) {
+        widest = std::max(widest, config_.titleQueue[i].size());
+        total += config_.titleQueue[i].size();
+    }
+    if (widest == 0) {
+        return 0;
+    }
+    config_.title.reserve(widest);
+    const std::size_t slots = std::min(targets_.size() + total, std::max<std::size_t>(cols, targets_.size()));
+    targets_.reserve(slots);
+    slot_particles_.reserve(slots);
+    free_slots_.reserve(slots);
+    return std::max(std::min<std::size_t>(widest, cols), targets_.size());
+}
+
+void RainAndConvergeEffect::reserve_particle() {
+    if (particles_.live().size() == particles_.capacity()) {
+        particles_.grow(std::max<std::size_t>(16, 2 * particles_.capacity()));
+    }
+}
+
+void RainAndConvergeEffect::spawn_title_particle(const Context& context, uint32_t slot, std::mt19937& rng) {
+    const ConvergeTarget& target = targets_[slot];
+    const float target_x = static_cast<float>(target.x);
+    const float target_y = static_cast<float>(target.y);
+
+    // The nearest visible stream head above the cell becomes the particle,
+    // trail and all, so the glyph drops out of rain that is already there.
+    std::size_t donor = streams_.size();
+    const std::size_t first = static_cast<std::size_t>(std::max(0.0f, target_x - kHandoverReach));
+    const std::size_t last = std::min(streams_.size(), static_cast<std::size_t>(target_x + kHandoverReach) + 1);
+    for (std::size_t index = first; index < last; ++index) {
+        const RainStream& stream = streams_[index];
+        if (stream.has(RainStream::kInactive) || stream.length == 0 || stream.y < 0.0f || stream.y >= target_y ||
+            std::abs(stream.x - target_x) > kHandoverReach) {
+            continue;
+        }
+        if (donor == streams_.size() || std::abs(stream.x - target_x) < std::abs(streams_[donor].x - target_x)) {
+            donor = index;
         }
-        const float distance = stream.targetY - stream.y;
-        if (config_.convergenceDuration > 0.0f) {
-            const float required_speed = distance / config_.convergenceDuration;
-            if (required_speed > 0.0f) {
-                const float randomness = std::clamp(config_.convergenceRandomness, 0.0f, 1.0f);
-                const float min_multiplier = std::max(0.1f, 1.0f - randomness);
-                const float max_multiplier = 1.0f + randomness;
-                std::uniform_real_distribution<float> multiplier_dist(min_multiplier, max_multiplier);
-                const float multiplier = multiplier_dist(rng);
-                stream.speed = required_speed * multiplier;
+    }
+
+    reserve_particle();
+    ParticlePool::Handle handle = ParticlePool::kInvalidHandle;
+    const auto& charset = glyphs_->glyphs;
+    if (donor != streams_.size()) {
+        RainStream& stream = streams_[donor];
+        handle = ConvergeEmitter::spawn(particles_, targets_, slot, stream.y, stream.speed, 1, charset, glyphs_->table, rng);
+        if (handle != ParticlePool::kInvalidHandle) {
+            const std::size_t length = std::min({static_cast<std::size_t>(stream.length),
+                                                 static_cast<std::size_t>(stream.maxLength), particles_.trail_capacity()});
+            char32_t* trail = particles_.trail(handle);
+            for (std::size_t i = 1; i < length; ++i) {
+                trail[i] = charset[streams_.glyph(donor, i)];
+            }
+            particles_.cold[handle].trailLength = static_cast<uint16_t>(std::max<std::size_t>(1, length));
+            if (stream.has(RainStream::kAllowRespawn)) {
+                reset_stream(donor, context, rng);
+            } else {
+                stream.length = 0;
+                stream.set(RainStream::kInactive, true);
             }
         }
-        targeted_streams_++;
+    } else {
+        handle = ConvergeEmitter::emit_one(particles_, targets_, slot, emitter_settings(context), charset, glyphs_->table, rng);
+    }
+
+    if (handle == ParticlePool::kInvalidHandle) {
+        targets_[slot].landed = true;
+        landed_targets_++;
+    }
+}
+
+void RainAndConvergeEffect::dissolve_title_glyph(const Context& context, uint32_t slot, std::mt19937& rng) {
+    const float min_speed = std::min(config_.rainConfig.minSpeed, config_.rainConfig.maxSpeed);
+    const float max_speed = std::max(config_.rainConfig.minSpeed, config_.rainConfig.maxSpeed);
+    std::uniform_real_distribution<float> speed_dist(min_speed, max_speed);
+
+    // The landed glyph leads a fresh trail down and off the screen.
+    reserve_particle();
+    const ConvergeTarget& target = targets_[slot];
+    const ParticlePool::Handle handle =
+        ConvergeEmitter::spawn(particles_, targets_, slot, static_cast<float>(target.y), speed_dist(rng),
+                               static_cast<int>(particles_.trail_capacity()), glyphs_->glyphs,
+                               glyphs_->table, rng);
+    if (handle == ParticlePool::kInvalidHandle) {
+        return;
     }
+    auto& cold = particles_.cold[handle];
+    cold.state = ParticlePool::State::Dissolving;
+    cold.targetY = static_cast<float>(context.rows);
+    cold.trailLength = 1;
 }
 
-void RainAndConvergeEffect::reset_stream(ExtendedRainStream& stream, const Context& context, std::mt19937& rng) {
+void RainAndConvergeEffect::reset_stream(std::size_t index, const Context& context, std::mt19937& rng) {
+    RainStream& stream = streams_[index];
     const float min_speed = std::min(config_.rainConfig.minSpeed, config_.rainConfig.maxSpeed);
     const float max_speed = std::max(config_.rainConfig.minSpeed, config_.rainConfig.maxSpeed);
     std::uniform_real_distribution<float> speed_dist(min_speed, max_speed);
 
-    const int min_length = std::max(1, std::min(config_.rainConfig.minLength, config_.rainConfig.maxLength));
-    const int max_length = std::max(min_length, config_.rainConfig.maxLength);
+    const int max_length = std::clamp(config_.rainConfig.maxLength, 1, static_cast<int>(streams_.trail_capacity()));
+    const int min_length = std::clamp(config_.rainConfig.minLength, 1, max_length);
     std::uniform_int_distribution<int> length_dist(min_length, max_length);
 
-    stream.maxLength = length_dist(rng);
+    stream.maxLength = static_cast<uint16_t>(length_dist(rng));
     std::uniform_int_distribution<int> current_length_dist(min_length, stream.maxLength);
-    stream.length = current_length_dist(rng);
+    stream.length = static_cast<uint16_t>(current_length_dist(rng));
     stream.speed = speed_dist(rng);
 
     if (context.rows > 0) {
@@ -210,111 +369,41 @@ void RainAndConvergeEffect::reset_stream(ExtendedRainStream& stream, const Conte
         stream.y = 0.0f;
     }
 
-    stream.state = ExtendedRainStream::State::NORMAL;
-    stream.isTitleStream = false;
-    stream.titleChar = U' ';
-    stream.targetY = 0.0f;
-    stream.convergenceElapsed = 0.0f;
-    stream.hasLeadChar = true;
-    stream.allowRespawn = true;
-    stream.inactive = false;
-    stream.characters.resize(stream.maxLength);
-    for (auto& character : stream.characters) {
-        character = random_character(rng);
-    }
+    stream.set(RainStream::kLeadChar, true);
+    stream.set(RainStream::kAllowRespawn, true);
+    stream.set(RainStream::kInactive, false);
+    streams_.fill_trail(index, stream.maxLength, glyphs_->table, rng);
 }
 
-void RainAndConvergeEffect::update_stream(ExtendedRainStream& stream, const Context& context, float delta, std::mt19937& rng) {
-    if (stream.inactive) {
+void RainAndConvergeEffect::update_stream(std::size_t index, const Context& context, float delta, std::mt19937& rng, bool respawn_enabled) {
+    RainStream& stream = streams_[index];
+    if (stream.has(RainStream::kInactive)) {
         return;
     }
 
     std::uniform_real_distribution<float> shimmer_dist(0.0f, 1.0f);
+    const float shimmer_chance = 0.1f * context.quality.shimmer;
 
-    switch (stream.state) {
-    case ExtendedRainStream::State::NORMAL: {
-        stream.y += stream.speed * delta;
-        stream.x += stream.speed * x_velocity_per_unit_y_ * delta;
+    stream.y += stream.speed * delta;
+    stream.x += stream.speed * x_velocity_per_unit_y_ * delta;
 
-        if (stream.length < stream.maxLength) {
-            stream.length = std::min(stream.maxLength, stream.length + 1);
-        }
-
-        if (!stream.characters.empty() && shimmer_dist(rng) < 0.1f) {
-            std::uniform_int_distribution<std::size_t> index_dist(0, stream.characters.size() - 1);
-            const std::size_t index = index_dist(rng);
-            stream.characters[index] = random_character(rng);
-        }
-
-        if ((stream.y - static_cast<float>(stream.length)) > static_cast<float>(context.rows)) {
-            if (!stream.isTitleStream) {
-                if (stream.allowRespawn) {
-                    reset_stream(stream, context, rng);
-                } else {
-                    stream.length = 0;
-                    stream.inactive = true;
-                }
-            } else {
-                stream.y = -static_cast<float>(stream.length);
-            }
-        }
-        break;
+    if (stream.length < stream.maxLength) {
+        stream.length++;
     }
-    case ExtendedRainStream::State::CONVERGING: {
-        stream.convergenceElapsed += delta;
-        stream.y += stream.speed * delta;
-        if (!stream.characters.empty()) {
-            stream.characters[0] = stream.titleChar;
-        }
-
-        if (!stream.characters.empty() && shimmer_dist(rng) < 0.1f) {
-            std::uniform_int_distribution<std::size_t> index_dist(0, stream.characters.size() - 1);
-            const std::size_t index = index_dist(rng);
-            if (index != 0) {
-                stream.characters[index] = random_character(rng);
-            }
-        }
 
-        if (stream.y >= stream.targetY) {
-            stream.y = stream.targetY;
-            stream.state = ExtendedRainStream::State::IN_PLACE;
-        }
-        break;
+    if (stream.maxLength > 0 && shimmer_dist(rng) < shimmer_chance) {
+        std::uniform_int_distribution<std::size_t> index_dist(0, stream.maxLength - 1U);
+        const std::size_t glyph_index = index_dist(rng);
+        streams_.set_glyph(index, glyph_index, random_glyph(rng));
     }
-    case ExtendedRainStream::State::IN_PLACE: {
-        stream.y += stream.speed * delta;
-        stream.x += stream.speed * x_velocity_per_unit_y_ * delta;
-
-        if (stream.length < stream.maxLength) {
-            stream.length = std::min(stream.maxLength, stream.length + 1);
-        }
 
-        if (!stream.characters.empty() && shimmer_dist(rng) < 0.1f) {
-            std::uniform_int_distribution<std::size_t> index_dist(0, stream.characters.size() - 1);
-            const std::size_t index = index_dist(rng);
-            stream.characters[index] = random_character(rng);
+    if ((stream.y - static_cast<float>(stream.length)) > static_cast<float>(context.rows)) {
+        if (stream.has(RainStream::kAllowRespawn) && respawn_enabled) {
+            reset_stream(index, context, rng);
+        } else {
+            stream.length = 0;
+            stream.set(RainStream::kInactive, true);
         }
-
-        const int available_chars = std::min(stream.length, static_cast<int>(stream.characters.size()));
-        if (available_chars > 0) {
-            const float tail_y = stream.y - static_cast<float>(available_chars - 1);
-            if (tail_y >= stream.targetY) {
-                stream.inactive = true;
-                stream.allowRespawn = false;
-                break;
-            }
-        }
-
-        if ((stream.y - static_cast<float>(stream.length)) > static_cast<float>(context.rows)) {
-            if (!stream.isTitleStream && stream.allowRespawn) {
-                reset_stream(stream, context, rng);
-            } else {
-                stream.length = 0;
-                stream.inactive = true;
-            }
-        }
-        break;
-    }
     }
 
     if (context.cols > 0) {
@@ -328,6 +417,15 @@ void RainAndConvergeEffect::update_stream(ExtendedRainStream& stream, const Cont
     }
 }
 
+bool RainAndConvergeEffect::column_enabled(std::size_t index, float density) {
+    if (density >= 1.0f) {
+        return true;
+    }
+    // Stable per-column hash so the same columns go quiet at a given density.
+    const auto hashed = static_cast<uint32_t>(index * 2654435761U) >> 16U;
+    return static_cast<float>(hashed & 0xFFFFU) < density * 65536.0f;
+}
+
 void RainAndConvergeEffect::update(const Context& context) {
     ensure_initialized(context);
     if (streams_.empty() || context.cols == 0) {
@@ -335,134 +433,301 @@ void RainAndConvergeEffect::update(const Context& context) {
     }
 
     const float delta = (context.deltaTime > 0.0f) ? context.deltaTime : kDefaultFrameTime;
-    std::mt19937 fallback_rng{std::random_device{}()};
-    std::mt19937& rng = resolve_rng(context, fallback_rng);
+    std::mt19937& rng = resolve_rng(context, fallback_rng_);
+    const AudioResponse audio = audio_response(config_.rainConfig, context);
+    lead_brightness_ = audio.brightness;
 
-    bool all_targets_in_place = targeted_streams_ > 0;
-    bool all_streams_cleared = true;
+    if (pending_title_) {
+        if (!has_mask_ && *pending_title_ != config_.title) {
+            morph_title(context, *pending_title_, rng);
+        }
+        pending_title_.reset();
+    }
 
-    for (auto& stream : streams_) {
-        if (draining_rain_ && !stream.isTitleStream) {
-            stream.allowRespawn = false;
+    // Only falling and parked streams need a visit; a drained stream never
+    // comes back. Both lists are walked merged in column order, so the RNG is
+    // drawn in the same order as a scan of every column would.
+    next_falling_.clear();
+    next_parked_.clear();
+    live_streams_ = 0;
+    std::size_t falling = 0;
+    std::size_t parked = 0;
+    while (falling < falling_.size() || parked < parked_.size()) {
+        const bool take_falling = parked == parked_.size() || (falling < falling_.size() && falling_[falling] < parked_[parked]);
+        const std::size_t stream_index = take_falling ? falling_[falling++] : parked_[parked++];
+        const RainStream& stream = streams_[stream_index];
+        if (draining_rain_) {
+            streams_[stream_index].set(RainStream::kAllowRespawn, false);
         }
 
-        update_stream(stream, context, delta, rng);
-        if (stream.isTitleStream) {
-            if (stream.state != ExtendedRainStream::State::IN_PLACE) {
-                all_targets_in_place = false;
-            }
+        // Streams parked by a lower governor density come back once it rises.
+        const bool respawn_enabled = column_enabled(stream_index, context.quality.density * audio.density);
+        if (stream.has(RainStream::kInactive) && stream.has(RainStream::kAllowRespawn) && respawn_enabled) {
+            reset_stream(stream_index, context, rng);
         }
 
-        if (!stream.isTitleStream) {
-            if (!stream.inactive && stream.length > 0) {
-                all_streams_cleared = false;
+        update_stream(stream_index, context, delta * audio.speed, rng, respawn_enabled);
+        if (!stream.has(RainStream::kInactive)) {
+            next_falling_.push_back(static_cast<uint32_t>(stream_index));
+            if (stream.length > 0) {
+                live_streams_++;
             }
+        } else if (stream.has(RainStream::kAllowRespawn)) {
+            next_parked_.push_back(static_cast<uint32_t>(stream_index));
         }
     }
+    falling_.swap(next_falling_);
+    parked_.swap(next_parked_);
+
+    const float shimmer_chance = 0.1f * context.quality.shimmer;
+    landed_targets_ += converge_.update(particles_, targets_, delta, shimmer_chance, glyphs_->glyphs, glyphs_->table, rng);
 
-    if (all_targets_in_place && targeted_streams_ > 0 && !all_in_place_) {
+    const bool last_title = has_mask_ || next_title_ >= config_.titleQueue.size();
+    if (!targets_.empty() && landed_targets_ == active_targets_ && !all_in_place_) {
         all_in_place_ = true;
-        draining_rain_ = true;
+        draining_rain_ = last_title;
+    }
+
+    if (all_in_place_ && !last_title) {
+        hold_elapsed_ += delta;
+        if (hold_elapsed_ >= config_.titleHold) {
+            morph_title(context, config_.titleQueue[next_title_++], rng);
+        }
     }
 
-    if (draining_rain_ && all_streams_cleared) {
+    if (draining_rain_ && live_streams_ == 0 && particles_.empty()) {
         rain_drained_ = true;
     }
 }
 
+template <typename Emit>
+void RainAndConvergeEffect::for_each_glyph(const Context& context, unsigned passes, Emit&& emit) const {
+    const color::Rgb lead = color::decode_rgba(config_.rainConfig.leadCharColor);
+    trail_kernel::Frame frame{};
+    frame.lead = color::scale(lead, lead_brightness_);
+    frame.tail = color::decode_rgba(config_.rainConfig.tailColor);
+    frame.slope = x_velocity_per_unit_y_;
+    frame.rows = static_cast<int>(context.rows);
+    frame.cols = static_cast<int>(context.cols);
+    frame.fadeLevels = context.output.fadeLevels;
+    const float trail_scale = std::clamp(context.quality.trailLength, 0.0f, 1.0f);
+    const auto drawn_length = [&](int length) {
+        return std::max(1, static_cast<int>(std::ceil(static_cast<float>(length) * trail_scale)));
+    };
+
+    // Rain streams and title particles share the trail kernel; particles
+    // that are flowing into their landed glyph are clipped at it.
+    constexpr int kNoClip = std::numeric_limits<int>::max();
+    trail_kernel::dispatch(x_velocity_per_unit_y_ != 0.0f, streams_.wide(), [&](auto slanted, auto index_type) {
+        using Index = decltype(index_type);
+        constexpr bool kSlanted = decltype(slanted)::value;
+        if ((passes & kStreams) != 0U) {
+            for (const uint32_t index : falling_) {
+                const RainStream& stream = streams_[index];
+                if (stream.maxLength == 0) {
+                    continue;
+                }
+                const int length = std::min<int>(stream.length, stream.maxLength);
+                const int drawn = drawn_length(length);
+                const trail_kernel::IndexedGlyphs<Index> glyphs{streams_.trail<Index>(index),
+                                                                glyphs_->glyphs.data()};
+                trail_kernel::draw<kSlanted>(frame, stream.x, stream.y, glyphs, std::min(drawn, length), drawn,
+                                             stream.has(RainStream::kLeadChar), kNoClip, emit);
+            }
+        }
+
+        if ((passes & kTitle) != 0U) {
+            for (const auto& target : targets_) {
+                if (target.landed) {
+                    emit(target.y, target.x, target.glyph, lead, true);
+                }
+            }
+        }
+
+        if ((passes & kParticles) == 0U) {
+            return;
+        }
+        for (const ParticlePool::Handle handle : particles_.live()) {
+            const auto& cold = particles_.cold[handle];
+            const bool absorbing = cold.state == ParticlePool::State::Absorbing;
+            const int drawn = drawn_length(cold.trailLength);
+            trail_kernel::draw<kSlanted>(frame, particles_.hot.x[handle], particles_.hot.y[handle], particles_.trail(handle),
+                                         std::min<int>(drawn, cold.trailLength), drawn, true,
+                                         absorbing ? static_cast<int>(cold.targetY) : kNoClip, emit);
+        }
+    });
+}
+
 void RainAndConvergeEffect::render(const Context& context) {
     if (context.root_plane == nullptr) {
         return;
     }
 
     ensure_initialized(context);
+    ncplane_erase(context.root_plane);
     if (streams_.empty()) {
-        ncplane_erase(context.root_plane);
         return;
     }
 
-    ncplane_erase(context.root_plane);
-
-    uint8_t lead_r = 0, lead_g = 0, lead_b = 0;
-    uint8_t tail_r = 0, tail_g = 0, tail_b = 0;
-    decode_rgba(config_.rainConfig.leadCharColor, lead_r, lead_g, lead_b);
-    decode_rgba(config_.rainConfig.tailColor, tail_r, tail_g, tail_b);
-
-    for (const auto& stream : streams_) {
-        const bool stream_in_place = stream.state == ExtendedRainStream::State::IN_PLACE;
-        if (stream_in_place && stream.titleChar != U' ') {
-            ncplane_set_fg_rgb8(context.root_plane, lead_r, lead_g, lead_b);
-            ncplane_on_styles(context.root_plane, NCSTYLE_BOLD);
-            const std::string glyph_utf8 = encode_utf8(stream.titleChar);
-            ncplane_putegc_yx(context.root_plane, static_cast<int>(stream.targetY), static_cast<int>(stream.x), glyph_utf8.c_str(), nullptr);
-        }
+    color::Pen pen(context.root_plane, context.output.palette256);
+    char glyph_utf8[5];
+    for_each_glyph(context, kAllPasses, [&](int y, int x, char32_t glyph, color::Rgb fg, bool bold) {
+        pen.set(fg, bold);
+        glyph_utf8[utf8::encode(glyph, glyph_utf8)] = '\0';
+        ncplane_putegc_yx(context.root_plane, y, x, glyph_utf8, nullptr);
+    });
 
-        if (stream.inactive && !stream.isTitleStream) {
-            continue;
-        }
-
-        const int available_chars = std::min(stream.length, static_cast<int>(stream.characters.size()));
-        for (int i = 0; i < available_chars; ++i) {
-            const int screen_y = static_cast<int>(stream.y) - i;
-            const float horizontal_offset = static_cast<float>(i) * x_velocity_per_unit_y_;
-            const float raw_screen_x = stream.x - horizontal_offset;
-            int screen_x = static_cast<int>(std::round(raw_screen_x));
-
-            if (stream_in_place && screen_y >= static_cast<int>(stream.targetY)) {
-                continue;
-            }
-
-            if (screen_y < 0 || screen_y >= static_cast<int>(context.rows)) {
-                continue;
-            }
-
-            if (context.cols > 0) {
-                const int cols_int = static_cast<int>(context.cols);
-                while (screen_x < 0) {
-                    screen_x += cols_int;
-                }
-                while (screen_x >= cols_int) {
-                    screen_x -= cols_int;
-                }
-            }
-
-            if (screen_x < 0 || screen_x >= static_cast<int>(context.cols)) {
-                continue;
-            }
+    if (rain_drained_) {
+        has_rendered_post_drain_ = true;
+    }
 
-            if (i == 0 && stream.hasLeadChar) {
-                ncplane_set_fg_rgb8(context.root_plane, lead_r, lead_g, lead_b);
-                ncplane_on_styles(context.root_plane, NCSTYLE_BOLD);
-            } else {
-                const float t = static_cast<float>(i) / std::max(1, stream.length - 1);
-                const float base = (1.0f - t);
-                const uint8_t r = static_cast<uint8_t>(static_cast<float>(tail_r) * base);
-                const uint8_t g = static_cast<uint8_t>(static_cast<float>(tail_g) * base);
-                const uint8_t b = static_cast<uint8_t>(static_cast<float>(tail_b) * base);
-                ncplane_set_fg_rgb8(context.root_plane, r, g, b);
-                ncplane_off_styles(context.root_plane, NCSTYLE_BOLD);
-            }
+    ncplane_off_styles(context.root_plane, NCSTYLE_BOLD);
+}
 
-            const char32_t glyph_code = stream.characters.empty() ? U' ' : stream.characters[static_cast<std::size_t>(std::min(i, available_chars - 1))];
-            const std::string glyph_utf8 = encode_utf8(glyph_code);
-            ncplane_putegc_yx(context.root_plane, screen_y, screen_x, glyph_utf8.c_str(), nullptr);
-        }
+bool RainAndConvergeEffect::record(const Context& context, DrawList& list) {
+    ensure_initialized(context);
+    const uint8_t lead_alpha = color::decode_alpha(config_.rainConfig.leadCharColor);
+    const uint8_t tail_alpha = color::decode_alpha(config_.rainConfig.tailColor);
+    const auto emit = [&](int y, int x, char32_t glyph, color::Rgb fg, bool bold) {
+        list.cell(y, x, glyph, fg, bold ? NCSTYLE_BOLD : 0U, bold ? lead_alpha : tail_alpha);
+    };
+
+    if (config_.rainOverTitle) {
+        // The held title is the bottom layer; translucent rain and incoming
+        // particles blend over it instead of replacing its cells.
+        for_each_glyph(context, kTitle, emit);
+        list.begin_layer();
+        for_each_glyph(context, kStreams | kParticles, emit);
+    } else {
+        for_each_glyph(context, kAllPasses, emit);
     }
 
     if (rain_drained_) {
         has_rendered_post_drain_ = true;
     }
+    return true;
+}
 
-    ncplane_off_styles(context.root_plane, NCSTYLE_BOLD);
+bool RainAndConvergeEffect::isStatic() const {
+    // The landed title does not shimmer; only rain and particles move.
+    return rain_drained_ && has_rendered_post_drain_;
 }
 
 bool RainAndConvergeEffect::isFinished() const {
     if (config_.rainConfig.duration > 0.0f) {
         return false;
     }
-    if (targeted_streams_ == 0) {
+    if (targets_.empty()) {
         return false;
     }
     return rain_drained_ && has_rendered_post_drain_;
 }
 
+bool RainAndConvergeEffect::copy_to(Effect& target) const {
+    auto* other = dynamic_cast<RainAndConvergeEffect*>(&target);
+    if (other == nullptr) {
+        return false;
+    }
+    // The stream lists, title slots and particle lists change length from
+    // frame to frame. The target gets the capacity reserved here, so any
+    // later copy fits as well.
+    const auto reserve_like = [](auto& to, const auto& from) { to.reserve(from.capacity()); };
+    reserve_like(other->falling_, falling_);
+    reserve_like(other->parked_, parked_);
+    reserve_like(other->next_falling_, next_falling_);
+    reserve_like(other->next_parked_, next_parked_);
+    reserve_like(other->targets_, targets_);
+    reserve_like(other->title_slots_, title_slots_);
+    reserve_like(other->free_slots_, free_slots_);
+    reserve_like(other->slot_particles_, slot_particles_);
+    reserve_like(other->config_.title, config_.title);
+    other->particles_.reserve_like(particles_);
+    *other = *this;
+    return true;
+}
+
+bool RainAndConvergeEffect::save(SnapshotWriter& out) const {
+    out.put<uint64_t>(glyphs_->glyphs.size());
+    out.put(initialized_);
+    out.put(cached_cols_);
+    out.put(cached_rows_);
+    streams_.save(out);
+    out.put_array(falling_);
+    out.put_array(parked_);
+    out.put<uint64_t>(live_streams_);
+    out.put_array(config_.title);
+    out.put(pending_title_.has_value());
+    out.put_array(pending_title_.value_or(std::u32string{}));
+    out.put<uint64_t>(next_title_);
+    out.put(hold_elapsed_);
+    out.put_array(targets_);
+    out.put_array(title_slots_);
+    out.put_array(free_slots_);
+    out.put<uint64_t>(active_targets_);
+    out.put<uint64_t>(landed_targets_);
+    out.put(has_mask_);
+    particles_.save(out);
+    out.put(x_velocity_per_unit_y_);
+    out.put(lead_brightness_);
+    out.put(all_in_place_);
+    out.put(has_rendered_post_drain_);
+    out.put(draining_rain_);
+    out.put(rain_drained_);
+    return true;
+}
+
+bool RainAndConvergeEffect::load(SnapshotReader& in) {
+    uint64_t glyph_count = 0;
+    uint64_t live_streams = 0;
+    bool has_pending_title = false;
+    std::u32string pending_title;
+    uint64_t next_title = 0;
+    uint64_t active_targets = 0;
+    uint64_t landed_targets = 0;
+    if (!in.get(glyph_count) || glyph_count != glyphs_->glyphs.size() || !in.get(initialized_) || !in.get(cached_cols_) ||
+        !in.get(cached_rows_) || !streams_.load(in, glyphs_->glyphs.size()) || !in.get_array(falling_) ||
+        !in.get_array(parked_) || !in.get(live_streams) || !in.get_array(config_.title) || !in.get(has_pending_title) ||
+        !in.get_array(pending_title) || !in.get(next_title) || !in.get(hold_elapsed_) || !in.get_array(targets_) ||
+        !in.get_array(title_slots_) || !in.get_array(free_slots_) || !in.get(active_targets) || !in.get(landed_targets) ||
+        !in.get(has_mask_) || !particles_.load(in) || !in.get(x_velocity_per_unit_y_) || !in.get(lead_brightness_) ||
+        !in.get(all_in_place_) || !in.get(has_rendered_post_drain_) || !in.get(draining_rain_) || !in.get(rain_drained_)) {
+        return false;
+    }
+
+    const std::size_t streams = streams_.size();
+    const std::size_t targets = targets_.size();
+    const auto stream_index = [streams](uint32_t index) { return index < streams; };
+    // kNoSlot marks an empty column of the title row; a free slot is always
+    // a real target.
+    const auto slot_index = [targets](uint32_t slot) { return slot == kNoSlot || slot < targets; };
+    const auto target_index = [targets](uint32_t slot) { return slot < targets; };
+    if (streams != cached_cols_ || !std::all_of(falling_.begin(), falling_.end(), stream_index) ||
+        !std::all_of(parked_.begin(), parked_.end(), stream_index) || next_title > config_.titleQueue.size() ||
+        (!has_mask_ && title_slots_.size() != cached_cols_) || !std::all_of(title_slots_.begin(), title_slots_.end(), slot_index) ||
+        !std::all_of(free_slots_.begin(), free_slots_.end(), target_index) ||
+        std::any_of(particles_.live().begin(), particles_.live().end(), [&](ParticlePool::Handle handle) {
+            const ParticlePool::Cold& cold = particles_.cold[handle];
+            return cold.state != ParticlePool::State::Dissolving && cold.target >= targets;
+        })) {
+        return false;
+    }
+    live_streams_ = static_cast<std::size_t>(live_streams);
+    next_title_ = static_cast<std::size_t>(next_title);
+    active_targets_ = static_cast<std::size_t>(active_targets);
+    landed_targets_ = static_cast<std::size_t>(landed_targets);
+    pending_title_.reset();
+    if (has_pending_title) {
+        pending_title_ = std::move(pending_title);
+    }
+
+    // The capacity a fresh run reserves, so the resumed run does not
+    // allocate either.
+    falling_.reserve(cached_cols_);
+    parked_.reserve(cached_cols_);
+    next_falling_.reserve(cached_cols_);
+    next_parked_.reserve(cached_cols_);
+    if (!has_mask_) {
+        reserve_title_queue(cached_cols_);
+    }
+    return true;
+}
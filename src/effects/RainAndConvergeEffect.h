@@ -1,8 +1,12 @@
 #pragma once
 
+#include "effects/ConvergeMask.h"
+#include "effects/ParticleSystem.h"
 #include "effects/RainEffect.h"
 
 #include <chrono>
+#include <memory>
+#include <optional>
 #include <random>
 #include <string>
 #include <vector>
@@ -13,6 +17,16 @@ struct RainAndConvergeConfig {
     float convergenceDuration{5.0f};
     float convergenceRandomness{0.0f};
     unsigned int titleRow{0};
+    // Text-art (.txt) or image file the particles converge into instead of
+    // the single-row title; the title is used if it cannot be loaded.
+    std::string maskFile{};
+    // Draw the rain in a layer above the landed title instead of beneath it.
+    bool rainOverTitle{false};
+    // Titles shown after `title`, in order. Each one replaces the previous
+    // title `titleHold` seconds after it has landed; the rain drains after
+    // the last. Not used with a mask.
+    std::vector<std::u32string> titleQueue{};
+    float titleHold{3.0f};
 };
 
 class RainAndConvergeEffect : public Effect {
@@ -22,39 +36,89 @@ public:
     void update(const Context& context) override;
     void render(const Context& context) override;
     bool isFinished() const override;
+    bool record(const Context& context, DrawList& list) override;
+    bool isStatic() const override;
+    Footprint footprint() const override { return Footprint{streams_.size(), streams_.footprint()}; }
+    std::unique_ptr<Effect> clone() const override { return std::make_unique<RainAndConvergeEffect>(*this); }
+    bool clonable() const override { return true; }
+    bool copy_to(Effect& target) const override;
+    bool save(SnapshotWriter& out) const override;
+    bool load(SnapshotReader& in) override;
 
-private:
-    struct ExtendedRainStream : RainStream {
-        enum class State { NORMAL, CONVERGING, IN_PLACE };
-
-        State state{State::NORMAL};
-        char32_t titleChar{U' '};
-        float targetY{0.0f};
-        bool isTitleStream{false};
-        float convergenceElapsed{0.0f};
-        bool allowRespawn{true};
-        bool inactive{false};
-    };
+    // Changes the title on the next update without laying the scene out
+    // again: cells that keep their glyph stay, glyphs that go dissolve into
+    // rain, and new ones drop in from nearby streams. Ignored with a mask.
+    void set_title(std::u32string title);
 
-    void ensure_character_set_loaded();
+private:
     void ensure_initialized(const Context& context);
     void initialize_streams(const Context& context);
-    void assign_title_streams(const Context& context, std::mt19937& rng);
-    void reset_stream(ExtendedRainStream& stream, const Context& context, std::mt19937& rng);
-    void update_stream(ExtendedRainStream& stream, const Context& context, float delta, std::mt19937& rng);
-    char32_t random_character(std::mt19937& rng) const;
-    static std::string encode_utf8(char32_t codepoint);
+    void assign_title_targets(const Context& context, std::mt19937& rng);
+    bool assign_mask_targets(const Context& context, std::mt19937& rng);
+    void morph_title(const Context& context, const std::u32string& title, std::mt19937& rng);
+    void spawn_title_particle(const Context& context, uint32_t slot, std::mt19937& rng);
+    void dissolve_title_glyph(const Context& context, uint32_t slot, std::mt19937& rng);
+    void reserve_particle();
+    // Reserves room for the widest queued title and returns the number of
+    // title cells reserved, or 0 without a queue.
+    std::size_t reserve_title_queue(unsigned int cols);
+    unsigned int title_left(const Context& context, std::size_t width) const;
+    unsigned int title_row(const Context& context) const;
+    ConvergeEmitter::Settings emitter_settings(const Context& context) const;
+    void reset_stream(std::size_t index, const Context& context, std::mt19937& rng);
+    void update_stream(std::size_t index, const Context& context, float delta, std::mt19937& rng, bool respawn_enabled);
+    static bool column_enabled(std::size_t index, float density);
+    std::size_t random_glyph(std::mt19937& rng) const { return glyphs_->table.sample(rng); }
+    enum GlyphPass : unsigned {
+        kStreams = 1U << 0U,
+        kTitle = 1U << 1U,
+        kParticles = 1U << 2U,
+        kAllPasses = kStreams | kTitle | kParticles,
+    };
+
+    template <typename Emit>
+    void for_each_glyph(const Context& context, unsigned passes, Emit&& emit) const;
 
     RainAndConvergeConfig config_{};
-    std::vector<ExtendedRainStream> streams_{};
+    std::shared_ptr<const GlyphSet> glyphs_{};
+    // Rain streams, one per column; they are drained once the title is complete.
+    StreamPool streams_{};
+    // Indices of streams that are falling, and of streams parked by a lower
+    // density that may still come back, both in column order. Streams in
+    // neither list have drained for good. The next_ lists are scratch space.
+    std::vector<uint32_t> falling_{};
+    std::vector<uint32_t> parked_{};
+    std::vector<uint32_t> next_falling_{};
+    std::vector<uint32_t> next_parked_{};
+    // Falling streams with a visible trail; the drain is over at zero.
+    std::size_t live_streams_{0};
+    std::vector<ConvergeTarget> targets_{};
+    // Title target slot at each column of the title row, or kNoSlot. Slots
+    // emptied by a title change are reused before targets_ grows.
+    static constexpr uint32_t kNoSlot = 0xFFFFFFFFU;
+    std::vector<uint32_t> title_slots_{};
+    std::vector<uint32_t> free_slots_{};
+    // Scratch for morph_title: the particle converging on each slot.
+    std::vector<ParticlePool::Handle> slot_particles_{};
+    std::optional<std::u32string> pending_title_{};
+    std::size_t next_title_{0};
+    float hold_elapsed_{0.0f};
+    // Targets that hold a glyph; emptied slots do not count.
+    std::size_t active_targets_{0};
+    bool has_mask_{false};
+    ParticlePool particles_{};
+    ConvergeEmitter emitter_{};
+    ConvergeBehavior converge_{};
+    // Used only when the Context provides no engine RNG.
+    std::mt19937 fallback_rng_{};
     float x_velocity_per_unit_y_{0.0f};
+    float lead_brightness_{1.0f};
     bool initialized_{false};
     unsigned int cached_cols_{0};
     unsigned int cached_rows_{0};
     bool all_in_place_{false};
     bool has_rendered_post_drain_{false};
-    std::size_t targeted_streams_{0};
+    std::size_t landed_targets_{0};
     bool draining_rain_{false};
     bool rain_drained_{false};
 };
-
@@ -1,7 +1,9 @@
 #include "RainEffect.h"
 
 #include <algorithm>
+#include <charconv>
 #include <cmath>
+#include <functional>
 #include <fstream>
 #include <iterator>
 #include <limits>
@@ -11,73 +13,107 @@
 
 #include <notcurses/notcurses.h>
 
+#include "effects/TrailKernel.h"
+#include "utils/BuiltinCharsets.h"
+#include "utils/Color.h"
+#include "utils/CounterRng.h"
+#include "utils/SnapshotIo.h"
 #include "utils/Utf8.h"
 
 namespace {
 constexpr float kDefaultFrameTime = 1.0f / 60.0f;
 
+// Seekable mode timing. The simulated rain grows a trail by one glyph and
+// replaces the head glyph every frame, and shimmers one trail glyph with a
+// 10% chance per frame; these are the same rates per second at 60 fps.
+constexpr float kKeyframeInterval = 2.0f;
+constexpr std::size_t kMaxKeyframes = 32;
+constexpr float kLengthGrowthRate = 60.0f;
+constexpr float kHeadGlyphRate = 60.0f;
+constexpr float kShimmerRate = 6.0f;
+constexpr float kMinSeekSpeed = 0.01f;
+
+enum LifeField : std::uint64_t {
+    kSpeedField,
+    kMaxLengthField,
+    kLengthField,
+    kXField,
+    kYField,
+    kShimmerRateField,
+    kShimmerPhaseField,
+    kGlyphField,
+};
+
+// Packs a per-glyph field, the trail index and a change counter into one
+// hash counter.
+constexpr std::uint64_t glyph_counter(LifeField field, std::size_t index, std::uint64_t epoch = 0) {
+    return static_cast<std::uint64_t>(field) | (static_cast<std::uint64_t>(index) << 4U) | (epoch << 20U);
+}
+
 std::mt19937& resolve_rng(const Context& context, std::mt19937& fallback) {
     if (context.rng != nullptr) {
         return *context.rng;
     }
     return fallback;
 }
+} // namespace
 
-void decode_rgba(uint32_t color, uint8_t& r, uint8_t& g, uint8_t& b) {
-    r = static_cast<uint8_t>((color >> 24U) & 0xFFU);
-    g = static_cast<uint8_t>((color >> 16U) & 0xFFU);
-    b = static_cast<uint8_t>((color >> 8U) & 0xFFU);
-}
-
-std::string encode_utf8(char32_t codepoint) {
-    std::string out;
-    if (codepoint <= 0x7FU) {
-        out.push_back(static_cast<char>(codepoint));
-    } else if (codepoint <= 0x7FFU) {
-        out.push_back(static_cast<char>(0xC0U | ((codepoint >> 6U) & 0x1FU)));
-        out.push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
-    } else if (codepoint <= 0xFFFFU) {
-        out.push_back(static_cast<char>(0xE0U | ((codepoint >> 12U) & 0x0FU)));
-        out.push_back(static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU)));
-        out.push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
-    } else if (codepoint <= 0x10FFFFU) {
-        out.push_back(static_cast<char>(0xF0U | ((codepoint >> 18U) & 0x07U)));
-        out.push_back(static_cast<char>(0x80U | ((codepoint >> 12U) & 0x3FU)));
-        out.push_back(static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU)));
-        out.push_back(static_cast<char>(0x80U | (codepoint & 0x3FU)));
-    } else {
-        out.push_back('?');
+AudioResponse audio_response(const RainConfig& config, const Context& context) {
+    AudioResponse response;
+    if (!context.audio.active || context.seekable) {
+        return response;
     }
-    return out;
+    const AudioLevels& audio = context.audio;
+    const auto mix = [](float amount, float value) {
+        const float weight = std::clamp(amount, 0.0f, 1.0f);
+        return 1.0f - weight + weight * value;
+    };
+    response.density = mix(config.audioDensity, audio.level);
+    response.speed = mix(config.audioSpeed, 2.0f * audio.bass);
+    response.brightness = mix(config.audioBrightness, audio.treble);
+    return response;
 }
-} // namespace
 
-RainEffect::RainEffect(RainConfig config)
-    : config_(std::move(config)),
-      start_time_(std::chrono::steady_clock::now()) {
-    const float radians = config_.slantAngle * std::numbers::pi_v<float> / 180.0f;
-    x_velocity_per_unit_y_ = std::tan(radians);
-    ensure_character_set_loaded();
+void set_character_set(RainConfig& config, std::span<const char32_t> glyphs, std::span<const float> weights) {
+    config.characterSet.assign(glyphs.begin(), glyphs.end());
+    config.characterWeights.clear();
+    if (weights.size() == glyphs.size() && std::adjacent_find(weights.begin(), weights.end(), std::not_equal_to<>()) != weights.end()) {
+        config.characterWeights.assign(weights.begin(), weights.end());
+    }
 }
 
-void RainEffect::ensure_character_set_loaded() {
-    if (!config_.characterSet.empty()) {
+void load_character_set(RainConfig& config) {
+    if (!config.characterSet.empty()) {
         return;
     }
 
-    std::ifstream input(config_.characterSetFile, std::ios::binary);
-    if (input.is_open()) {
+    if (const auto* builtin = builtin_charsets::lookup(config.characterSetFile)) {
+        set_character_set(config, builtin->glyphs, builtin->weights);
+    } else if (std::ifstream input(config.characterSetFile, std::ios::binary); input.is_open()) {
+        std::vector<char32_t> glyphs;
+        std::vector<float> weights;
         std::string line;
         while (std::getline(input, line)) {
             if (!line.empty() && line.back() == '\r') {
                 line.pop_back();
             }
+            // "<glyphs>\t<weight>"; an unreadable weight counts as 1.
+            float weight = 1.0f;
+            if (const auto tab = line.find('\t'); tab != std::string::npos) {
+                const char* end = line.data() + line.size();
+                if (std::from_chars(line.data() + tab + 1, end, weight).ptr != end || !(weight >= 0.0f)) {
+                    weight = 1.0f;
+                }
+                line.resize(tab);
+            }
             const auto decoded = utf8::decode(line);
-            config_.characterSet.insert(config_.characterSet.end(), decoded.begin(), decoded.end());
+            glyphs.insert(glyphs.end(), decoded.begin(), decoded.end());
+            weights.insert(weights.end(), decoded.size(), weight);
         }
+        set_character_set(config, glyphs, weights);
     }
 
-    if (config_.characterSet.empty()) {
+    if (config.characterSet.empty()) {
         static constexpr char32_t fallback_chars[] = {
             U'0', U'1', U'2', U'3', U'4', U'5', U'6', U'7', U'8', U'9',
             U'A', U'B', U'C', U'D', U'E', U'F', U'G', U'H', U'I', U'J',
@@ -88,59 +124,133 @@ void RainEffect::ensure_character_set_loaded() {
             U'u', U'v', U'w', U'x', U'y', U'z',
             U'@', U'#', U'$', U'%', U'&', U'*'
         };
-        config_.characterSet.assign(std::begin(fallback_chars), std::end(fallback_chars));
+        config.characterSet.assign(std::begin(fallback_chars), std::end(fallback_chars));
+    }
+    if (config.characterSet.size() > StreamPool::kMaxCharset) {
+        config.characterSet.resize(StreamPool::kMaxCharset);
+    }
+    if (config.characterWeights.size() > config.characterSet.size()) {
+        config.characterWeights.resize(config.characterSet.size());
+    }
+}
+
+std::shared_ptr<const GlyphSet> share_glyph_set(RainConfig& config) {
+    if (config.glyphSet) {
+        return config.glyphSet;
+    }
+    load_character_set(config);
+    auto set = std::make_shared<GlyphSet>();
+    set->table = config.characterWeights.size() == config.characterSet.size() ? AliasTable(config.characterWeights)
+                                                                               : AliasTable(config.characterSet.size());
+    set->glyphs = std::move(config.characterSet);
+    config.characterSet.clear();
+    config.characterWeights.clear();
+    config.glyphSet = std::move(set);
+    return config.glyphSet;
+}
+
+RainEffect::RainEffect(RainConfig config)
+    : config_(std::move(config)),
+      fallback_rng_(std::random_device{}()) {
+    const float radians = config_.slantAngle * std::numbers::pi_v<float> / 180.0f;
+    x_velocity_per_unit_y_ = std::tan(radians);
+    if (!config_.curves.slantAngle.empty()) {
+        slope_curve_ = config_.curves.slantAngle.map([](float degrees) { return std::tan(degrees * std::numbers::pi_v<float> / 180.0f); });
+    }
+    layout_density_ = config_.curves.density.empty() ? config_.density : config_.curves.density.max();
+    layout_density_ = std::max(layout_density_, std::numeric_limits<float>::min());
+    apply_curves(0.0f);
+    glyphs_ = share_glyph_set(config_);
+}
+
+void RainEffect::apply_curves(float time) {
+    const RainCurves& curves = config_.curves;
+    lead_color_ = curves.leadCharColor.empty() ? config_.leadCharColor : curves.leadCharColor.at(time);
+    tail_color_ = curves.tailColor.empty() ? config_.tailColor : curves.tailColor.at(time);
+    if (!slope_curve_.empty()) {
+        x_velocity_per_unit_y_ = slope_curve_.at(time);
     }
+    density_ = density_at(time);
 }
 
-char32_t RainEffect::random_character(std::mt19937& rng) const {
-    if (config_.characterSet.empty()) {
-        return U' ';
+float RainEffect::density_at(float time) const {
+    if (config_.curves.density.empty()) {
+        return 1.0f;
     }
+    return std::clamp(config_.curves.density.at(time) / layout_density_, 0.0f, 1.0f);
+}
+
+void RainEffect::speed_range(float time, float& min_speed, float& max_speed) const {
+    const float low = config_.curves.minSpeed.empty() ? config_.minSpeed : config_.curves.minSpeed.at(time);
+    const float high = config_.curves.maxSpeed.empty() ? config_.maxSpeed : config_.curves.maxSpeed.at(time);
+    min_speed = std::min(low, high);
+    max_speed = std::max(low, high);
+}
 
-    std::uniform_int_distribution<std::size_t> dist(0, config_.characterSet.size() - 1);
-    return config_.characterSet[dist(rng)];
+float RainEffect::drift(float from, float to) const {
+    if (slope_curve_.empty()) {
+        return x_velocity_per_unit_y_ * (to - from);
+    }
+    return slope_curve_.integral(to) - slope_curve_.integral(from);
 }
 
 void RainEffect::ensure_initialized(const Context& context) {
-    if (context.cols == 0 || context.rows == 0) {
+    // In seekable mode seek() owns the stream layout.
+    if (context.cols == 0 || context.rows == 0 || seeking(context)) {
         return;
     }
+    if (config_.phosphor && (phosphor_.rows() != context.rows || phosphor_.cols() != context.cols)) {
+        phosphor_.resize(context.rows, context.cols);
+    }
 
-    const unsigned int desired_streams = std::max(1U, static_cast<unsigned int>(context.cols * config_.density));
+    const unsigned int desired_streams = std::max(1U, static_cast<unsigned int>(static_cast<float>(context.cols) * layout_density_));
     if (streams_.size() != desired_streams) {
-        streams_.resize(desired_streams);
         initialized_ = false;
     }
 
     if (!initialized_) {
-        for (auto& stream : streams_) {
-            stream.markedForReset = true;
+        // Parked streams get trail space too, so a rising density curve
+        // never allocates mid-run.
+        const int max_length = std::max(1, std::max(config_.minLength, config_.maxLength));
+        streams_.reset(desired_streams, static_cast<std::size_t>(max_length), glyphs_->glyphs.size());
+        if (config_.phosphor) {
+            lit_rows_.assign(desired_streams, -1);
         }
         initialized_ = true;
     }
 
-    for (auto& stream : streams_) {
-        if (stream.markedForReset) {
-            resetStream(stream, context);
+    const std::size_t active_streams = active_stream_count(context, density_);
+    for (std::size_t i = 0; i < active_streams; ++i) {
+        if (streams_[i].has(RainStream::kMarkedForReset)) {
+            resetStream(i, context);
         }
     }
 }
 
-void RainEffect::resetStream(RainStream& stream, const Context& context) {
-    std::mt19937 fallback_rng{std::random_device{}()};
-    std::mt19937& rng = resolve_rng(context, fallback_rng);
+std::size_t RainEffect::active_stream_count(const Context& context, float density) const {
+    // Streams past this index finish their current fall and then stay parked
+    // until the governor or the density curve raises density again.
+    const float scale = std::clamp(context.quality.density * density, 0.0f, 1.0f);
+    const auto active = static_cast<std::size_t>(std::ceil(static_cast<float>(streams_.size()) * scale));
+    return std::clamp<std::size_t>(active, 1, streams_.size());
+}
+
+void RainEffect::resetStream(std::size_t index, const Context& context) {
+    RainStream& stream = streams_[index];
+    std::mt19937& rng = resolve_rng(context, fallback_rng_);
 
-    const float min_speed = std::min(config_.minSpeed, config_.maxSpeed);
-    const float max_speed = std::max(config_.minSpeed, config_.maxSpeed);
+    float min_speed = 0.0f;
+    float max_speed = 0.0f;
+    speed_range(elapsed_, min_speed, max_speed);
     std::uniform_real_distribution<float> speed_dist(min_speed, max_speed);
 
-    const int min_length = std::max(1, std::min(config_.minLength, config_.maxLength));
-    const int max_length = std::max(min_length, config_.maxLength);
+    const int max_length = std::clamp(config_.maxLength, 1, static_cast<int>(streams_.trail_capacity()));
+    const int min_length = std::clamp(config_.minLength, 1, max_length);
     std::uniform_int_distribution<int> length_dist(min_length, max_length);
 
-    stream.maxLength = length_dist(rng);
+    stream.maxLength = static_cast<uint16_t>(length_dist(rng));
     std::uniform_int_distribution<int> current_length_dist(min_length, stream.maxLength);
-    stream.length = current_length_dist(rng);
+    stream.length = static_cast<uint16_t>(current_length_dist(rng));
 
     stream.speed = speed_dist(rng);
 
@@ -158,33 +268,88 @@ void RainEffect::resetStream(RainStream& stream, const Context& context) {
         stream.y = 0.0f;
     }
 
-    stream.markedForReset = false;
-    stream.hasLeadChar = true;
-    stream.characters.resize(stream.maxLength);
-    for (auto& character : stream.characters) {
-        character = random_character(rng);
+    stream.set(RainStream::kMarkedForReset, false);
+    stream.set(RainStream::kLeadChar, true);
+    streams_.fill_trail(index, stream.maxLength, glyphs_->table, rng);
+    if (config_.phosphor) {
+        lit_rows_[index] = -1;
     }
 }
 
+int RainEffect::phosphor_column(const RainStream& stream, int rows_above, int cols) const {
+    int column = static_cast<int>(std::round(stream.x - static_cast<float>(rows_above) * x_velocity_per_unit_y_));
+    trail_kernel::wrap_column(column, cols);
+    return column;
+}
+
+void RainEffect::light_cells(std::size_t index, const Context& context) {
+    const RainStream& stream = streams_[index];
+    const int head_row = static_cast<int>(stream.y);
+    const int first = std::max(lit_rows_[index] + 1, 0);
+    const int last = std::min(head_row, static_cast<int>(context.rows) - 1);
+    const int cols = static_cast<int>(context.cols);
+    // Usually a single row; more when a frame took long.
+    for (int row = first; row <= last; ++row) {
+        const int column = phosphor_column(stream, head_row - row, cols);
+        phosphor_.excite(static_cast<unsigned int>(row), static_cast<unsigned int>(column),
+                         glyphs_->glyphs[streams_.glyph(index, 0)]);
+    }
+    lit_rows_[index] = std::max(lit_rows_[index], head_row);
+}
+
+void RainEffect::decay_phosphor(const Context& context, float delta) {
+    float seconds = config_.phosphorDecay;
+    if (seconds <= 0.0f) {
+        const float length = 0.5f * static_cast<float>(config_.minLength + config_.maxLength);
+        const float speed = 0.5f * (config_.minSpeed + config_.maxSpeed);
+        seconds = length / std::max(speed, 1.0f);
+    }
+    // The governor's trail length shortens the glow.
+    seconds *= std::clamp(context.quality.trailLength, 0.05f, 1.0f);
+
+    decay_carry_ += 255.0f * delta / std::max(seconds, 0.01f);
+    const float steps = std::min(std::floor(decay_carry_), 255.0f);
+    decay_carry_ -= steps;
+    phosphor_.decay(static_cast<uint8_t>(steps));
+}
+
 void RainEffect::update(const Context& context) {
+    if (seeking(context)) {
+        seek(context);
+        return;
+    }
+
     ensure_initialized(context);
     if (streams_.empty() || context.cols == 0) {
         return;
     }
 
     const float delta = (context.deltaTime > 0.0f) ? context.deltaTime : kDefaultFrameTime;
-    std::mt19937 fallback_rng{std::random_device{}()};
-    std::mt19937& rng = resolve_rng(context, fallback_rng);
+    elapsed_ += delta;
+    apply_curves(elapsed_);
+    const AudioResponse audio = audio_response(config_, context);
+    density_ *= audio.density;
+    lead_brightness_ = audio.brightness;
+    const float step = delta * audio.speed;
+    std::mt19937& rng = resolve_rng(context, fallback_rng_);
     std::uniform_real_distribution<float> shimmer_dist(0.0f, 1.0f);
 
-    for (auto& stream : streams_) {
-        if (stream.markedForReset) {
-            resetStream(stream, context);
+    const float shimmer_chance = 0.1f * context.quality.shimmer;
+    const std::size_t active_streams = active_stream_count(context, density_);
+    if (config_.phosphor) {
+        decay_phosphor(context, delta);
+    }
+    for (std::size_t stream_index = 0; stream_index < streams_.size(); ++stream_index) {
+        auto& stream = streams_[stream_index];
+        if (stream.has(RainStream::kMarkedForReset)) {
+            if (stream_index < active_streams) {
+                resetStream(stream_index, context);
+            }
             continue;
         }
 
-        stream.y += stream.speed * delta;
-        stream.x += stream.speed * x_velocity_per_unit_y_ * delta;
+        stream.y += stream.speed * step;
+        stream.x += stream.speed * x_velocity_per_unit_y_ * step;
 
         if (context.cols > 0) {
             const float cols_f = static_cast<float>(context.cols);
@@ -197,97 +362,302 @@ void RainEffect::update(const Context& context) {
         }
 
         if (stream.length < stream.maxLength) {
-            stream.length = std::min(stream.maxLength, stream.length + 1);
+            stream.length++;
         }
 
-        if (!stream.characters.empty()) {
-            stream.characters[0] = random_character(rng);
+        if (stream.maxLength > 0) {
+            streams_.set_glyph(stream_index, 0, random_glyph(rng));
         }
 
-        if (!stream.characters.empty() && shimmer_dist(rng) < 0.1f) {
-            std::uniform_int_distribution<std::size_t> index_dist(0, stream.characters.size() - 1);
+        if (config_.phosphor) {
+            light_cells(stream_index, context);
+        }
+
+        if (stream.maxLength > 0 && shimmer_dist(rng) < shimmer_chance) {
+            std::uniform_int_distribution<std::size_t> index_dist(0, stream.maxLength - 1U);
             const std::size_t index = index_dist(rng);
-            stream.characters[index] = random_character(rng);
+            streams_.set_glyph(stream_index, index, random_glyph(rng));
+            const int row = static_cast<int>(stream.y) - static_cast<int>(index);
+            if (config_.phosphor && row >= 0 && row < static_cast<int>(context.rows)) {
+                const int column = phosphor_column(stream, static_cast<int>(index), static_cast<int>(context.cols));
+                phosphor_.shimmer(static_cast<unsigned int>(row), static_cast<unsigned int>(column),
+                                  glyphs_->glyphs[streams_.glyph(stream_index, index)]);
+            }
         }
 
         if ((stream.y - static_cast<float>(stream.length)) > static_cast<float>(context.rows)) {
-            stream.markedForReset = true;
+            stream.set(RainStream::kMarkedForReset, true);
         }
     }
 }
 
-void RainEffect::render(const Context& context) {
-    if (context.root_plane == nullptr) {
+RainEffect::Life RainEffect::life(std::size_t slot, const LifeCursor& cursor, const Context& context) const {
+    const auto draw = [&](LifeField field) { return counter_rng::hash(context.seed, slot, cursor.generation, field); };
+
+    const int min_length = std::clamp(std::min(config_.minLength, config_.maxLength), 1, RainStream::kMaxLength);
+    const int max_length = std::clamp(config_.maxLength, min_length, RainStream::kMaxLength);
+
+    float min_speed = 0.0f;
+    float max_speed = 0.0f;
+    speed_range(cursor.spawn, min_speed, max_speed);
+
+    Life life;
+    life.speed = counter_rng::uniform(draw(kSpeedField), min_speed, max_speed);
+    life.maxLength = counter_rng::uniform_int(draw(kMaxLengthField), min_length, max_length);
+    life.length = counter_rng::uniform_int(draw(kLengthField), min_length, life.maxLength);
+    life.x = counter_rng::uniform(draw(kXField), 0.0f, static_cast<float>(std::max(1U, context.cols) - 1U));
+    life.y = counter_rng::uniform(draw(kYField), -static_cast<float>(context.rows), 0.0f);
+    // The trail is fully grown long before it leaves the screen, so the fall
+    // ends once the tail of a full-length trail passes the bottom row.
+    // Far into a scene a short fall can vanish next to the spawn time in
+    // float; it still ends after its spawn, so walking the falls advances.
+    const float distance = static_cast<float>(context.rows) + static_cast<float>(life.maxLength) - life.y;
+    life.end = std::max(cursor.spawn + distance / std::max(life.speed, kMinSeekSpeed),
+                        std::nextafter(cursor.spawn, std::numeric_limits<float>::infinity()));
+    return life;
+}
+
+void RainEffect::ensure_seek_layout(const Context& context) {
+    const unsigned int desired_streams = std::max(1U, static_cast<unsigned int>(static_cast<float>(context.cols) * layout_density_));
+    if (context.rows == seek_rows_ && context.cols == seek_cols_ && cursors_.size() == desired_streams) {
         return;
     }
 
-    ensure_initialized(context);
-    if (streams_.empty()) {
-        ncplane_erase(context.root_plane);
+    // A new layout is a new scene: every slot starts its first fall at 0.
+    seek_rows_ = context.rows;
+    seek_cols_ = context.cols;
+    cursors_.assign(desired_streams, LifeCursor{});
+    keyframes_.clear();
+    keyframes_.reserve(kMaxKeyframes * cursors_.size());
+    keyframe_count_ = 0;
+    keyframe_interval_ = kKeyframeInterval;
+    cursor_time_ = 0.0f;
+
+    const int max_length = std::max(1, std::max(config_.minLength, config_.maxLength));
+    streams_.reset(desired_streams, static_cast<std::size_t>(max_length), glyphs_->glyphs.size());
+}
+
+void RainEffect::advance_cursors(float time, const Context& context) {
+    for (std::size_t slot = 0; slot < cursors_.size(); ++slot) {
+        LifeCursor& cursor = cursors_[slot];
+        for (float end = life(slot, cursor, context).end; end <= time; end = life(slot, cursor, context).end) {
+            cursor.spawn = end;
+            cursor.generation++;
+        }
+    }
+    cursor_time_ = time;
+}
+
+void RainEffect::seek(const Context& context) {
+    if (context.cols == 0 || context.rows == 0) {
         return;
     }
+    ensure_seek_layout(context);
 
-    ncplane_erase(context.root_plane);
+    const float time = std::max(0.0f, context.time);
+    if (time < cursor_time_) {
+        const auto keyframe = std::min(static_cast<std::size_t>(time / keyframe_interval_), keyframe_count_ - 1);
+        std::copy_n(keyframes_.begin() + static_cast<std::ptrdiff_t>(keyframe * cursors_.size()), cursors_.size(), cursors_.begin());
+        cursor_time_ = static_cast<float>(keyframe) * keyframe_interval_;
+    }
+    for (float next = static_cast<float>(keyframe_count_) * keyframe_interval_; next <= time;
+         next = static_cast<float>(keyframe_count_) * keyframe_interval_) {
+        advance_cursors(next, context);
+        if (keyframe_count_ == kMaxKeyframes) {
+            // Keep every other keyframe and double the interval, so a long
+            // run keeps a fixed number.
+            const auto stride = static_cast<std::ptrdiff_t>(cursors_.size());
+            for (std::size_t keyframe = 1; keyframe < kMaxKeyframes / 2; ++keyframe) {
+                std::copy_n(keyframes_.begin() + static_cast<std::ptrdiff_t>(keyframe * 2) * stride, cursors_.size(),
+                            keyframes_.begin() + static_cast<std::ptrdiff_t>(keyframe) * stride);
+            }
+            keyframes_.resize(kMaxKeyframes / 2 * cursors_.size());
+            keyframe_count_ = kMaxKeyframes / 2;
+            keyframe_interval_ *= 2.0f;
+        }
+        keyframes_.insert(keyframes_.end(), cursors_.begin(), cursors_.end());
+        keyframe_count_++;
+    }
+    advance_cursors(time, context);
 
-    uint8_t lead_r = 0, lead_g = 0, lead_b = 0;
-    uint8_t tail_r = 0, tail_g = 0, tail_b = 0;
-    decode_rgba(config_.leadCharColor, lead_r, lead_g, lead_b);
-    decode_rgba(config_.tailColor, tail_r, tail_g, tail_b);
+    elapsed_ = time;
+    apply_curves(time);
+    evaluate(context);
+}
 
-    for (const auto& stream : streams_) {
-        const int available_chars = std::min(stream.length, static_cast<int>(stream.characters.size()));
-        for (int i = 0; i < available_chars; ++i) {
-            const int screen_y = static_cast<int>(stream.y) - i;
-            const float horizontal_offset = static_cast<float>(i) * x_velocity_per_unit_y_;
-            const float raw_screen_x = stream.x - horizontal_offset;
-            int screen_x = static_cast<int>(std::round(raw_screen_x));
+bool RainEffect::copy_to(Effect& target) const {
+    auto* rain = dynamic_cast<RainEffect*>(&target);
+    if (rain == nullptr) {
+        return false;
+    }
+    // Every buffer keeps its size once the effect is laid out, so the
+    // copy reuses the target's storage.
+    *rain = *this;
+    return true;
+}
 
-            if (screen_y < 0 || screen_y >= static_cast<int>(context.rows)) {
-                continue;
-            }
+bool RainEffect::save(SnapshotWriter& out) const {
+    out.put<uint64_t>(glyphs_->glyphs.size());
+    streams_.save(out);
+    out.put(initialized_);
+    out.put(elapsed_);
+    out.put(x_velocity_per_unit_y_);
+    out.put(density_);
+    out.put(lead_color_);
+    out.put(tail_color_);
+    out.put(lead_brightness_);
+    if (config_.phosphor) {
+        out.put(decay_carry_);
+        out.put_array(lit_rows_);
+        phosphor_.save(out);
+    }
+    return true;
+}
 
-            if (context.cols > 0) {
-                const int cols_int = static_cast<int>(context.cols);
-                while (screen_x < 0) {
-                    screen_x += cols_int;
-                }
-                while (screen_x >= cols_int) {
-                    screen_x -= cols_int;
-                }
+bool RainEffect::load(SnapshotReader& in) {
+    uint64_t glyph_count = 0;
+    if (!in.get(glyph_count) || glyph_count != glyphs_->glyphs.size() || !streams_.load(in, glyphs_->glyphs.size()) ||
+        !in.get(initialized_) || !in.get(elapsed_) || !in.get(x_velocity_per_unit_y_) || !in.get(density_) ||
+        !in.get(lead_color_) || !in.get(tail_color_) || !in.get(lead_brightness_)) {
+        return false;
+    }
+    if (config_.phosphor) {
+        return in.get(decay_carry_) && in.get_array(lit_rows_) && lit_rows_.size() == streams_.size() && phosphor_.load(in);
+    }
+    return true;
+}
+
+void RainEffect::evaluate(const Context& context) {
+    const float cols_f = static_cast<float>(context.cols);
+    const float shimmer = std::max(0.0f, context.quality.shimmer);
+
+    for (std::size_t slot = 0; slot < streams_.size(); ++slot) {
+        RainStream& stream = streams_[slot];
+        const LifeCursor& cursor = cursors_[slot];
+        // As in playback, a slot's fall runs to the end once started, and a
+        // slot that was parked when it would have respawned stays hidden.
+        stream.set(RainStream::kMarkedForReset, slot >= active_stream_count(context, density_at(cursor.spawn)));
+        if (stream.has(RainStream::kMarkedForReset)) {
+            continue;
+        }
+
+        const Life fall = life(slot, cursor, context);
+        const float age = cursor_time_ - cursor.spawn;
+
+        stream.speed = fall.speed;
+        stream.maxLength = static_cast<uint16_t>(fall.maxLength);
+        stream.length = static_cast<uint16_t>(std::min(fall.maxLength, fall.length + static_cast<int>(age * kLengthGrowthRate)));
+        stream.y = fall.y + fall.speed * age;
+        stream.x = std::fmod(fall.x + fall.speed * drift(cursor.spawn, cursor_time_), cols_f);
+        if (stream.x < 0.0f) {
+            stream.x += cols_f;
+        }
+        stream.set(RainStream::kLeadChar, true);
+
+        // Each glyph is redrawn at its own rate; the glyph shown is a hash of
+        // how many times it has changed since the fall began.
+        for (std::size_t i = 0; i < stream.maxLength; ++i) {
+            float epochs = age * kHeadGlyphRate;
+            if (i > 0) {
+                const float rate_scale = 0.5f + counter_rng::unit(counter_rng::hash(context.seed, slot, cursor.generation, glyph_counter(kShimmerRateField, i)));
+                const float phase = counter_rng::unit(counter_rng::hash(context.seed, slot, cursor.generation, glyph_counter(kShimmerPhaseField, i)));
+                epochs = age * kShimmerRate * shimmer * rate_scale / static_cast<float>(fall.maxLength) + phase;
             }
+            const auto epoch = static_cast<std::uint64_t>(epochs);
+            const std::uint64_t bits = counter_rng::hash(context.seed, slot, cursor.generation, glyph_counter(kGlyphField, i, epoch));
+            streams_.set_glyph(slot, i, glyphs_->table.pick(static_cast<uint32_t>(bits >> 32U)));
+        }
+    }
+}
 
-            if (screen_x < 0 || screen_x >= static_cast<int>(context.cols)) {
+template <typename Emit>
+void RainEffect::for_each_glyph(const Context& context, bool heads_only, Emit&& emit) const {
+    trail_kernel::Frame frame{};
+    frame.lead = color::scale(color::decode_rgba(lead_color_), lead_brightness_);
+    frame.tail = color::decode_rgba(tail_color_);
+    frame.slope = x_velocity_per_unit_y_;
+    frame.rows = static_cast<int>(context.rows);
+    frame.cols = static_cast<int>(context.cols);
+    frame.fadeLevels = context.output.fadeLevels;
+
+    const float trail_scale = std::clamp(context.quality.trailLength, 0.0f, 1.0f);
+    trail_kernel::dispatch(x_velocity_per_unit_y_ != 0.0f, streams_.wide(), [&](auto slanted, auto index_type) {
+        using Index = decltype(index_type);
+        for (std::size_t index = 0; index < streams_.size(); ++index) {
+            const RainStream& stream = streams_[index];
+            if (stream.has(RainStream::kMarkedForReset)) {
                 continue;
             }
+            const int drawn_length = std::max(1, static_cast<int>(std::ceil(static_cast<float>(stream.length) * trail_scale)));
+            const int available_chars = heads_only ? 1 : std::min(drawn_length, static_cast<int>(stream.maxLength));
+            const trail_kernel::IndexedGlyphs<Index> glyphs{streams_.trail<Index>(index), glyphs_->glyphs.data()};
+            trail_kernel::draw<decltype(slanted)::value>(frame, stream.x, stream.y, glyphs, available_chars, drawn_length,
+                                                         stream.has(RainStream::kLeadChar), frame.rows, emit);
+        }
+    });
+}
 
-            if (i == 0 && stream.hasLeadChar) {
-                ncplane_set_fg_rgb8(context.root_plane, lead_r, lead_g, lead_b);
-                ncplane_on_styles(context.root_plane, NCSTYLE_BOLD);
-            } else {
-                const float t = static_cast<float>(i) / std::max(1, stream.length - 1);
-                const uint8_t r = static_cast<uint8_t>(static_cast<float>(tail_r) * (1.0f - t));
-                const uint8_t g = static_cast<uint8_t>(static_cast<float>(tail_g) * (1.0f - t));
-                const uint8_t b = static_cast<uint8_t>(static_cast<float>(tail_b) * (1.0f - t));
-                ncplane_set_fg_rgb8(context.root_plane, r, g, b);
-                ncplane_off_styles(context.root_plane, NCSTYLE_BOLD);
-            }
+void RainEffect::render(const Context& context) {
+    if (context.root_plane == nullptr) {
+        return;
+    }
 
-            const char32_t glyph_code = stream.characters.empty() ? U' ' : stream.characters[static_cast<std::size_t>(std::min(i, available_chars - 1))];
-            const std::string glyph_utf8 = encode_utf8(glyph_code);
-            ncplane_putegc_yx(context.root_plane, screen_y, screen_x, glyph_utf8.c_str(), nullptr);
+    ensure_initialized(context);
+    ncplane_erase(context.root_plane);
+    if (streams_.empty()) {
+        return;
+    }
+
+    color::Pen pen(context.root_plane, context.output.palette256);
+    char glyph_utf8[5];
+    const auto put = [&](int y, int x, char32_t glyph, color::Rgb fg, bool bold) {
+        pen.set(fg, bold);
+        glyph_utf8[utf8::encode(glyph, glyph_utf8)] = '\0';
+        ncplane_putegc_yx(context.root_plane, y, x, glyph_utf8, nullptr);
+    };
+    if (config_.phosphor && !seeking(context)) {
+        phosphor_.shade(color::decode_rgba(tail_color_), color::decode_alpha(tail_color_), context.output.fadeLevels);
+        const Framebuffer& cells = phosphor_.surface();
+        for (unsigned int y = 0; y < cells.rows; ++y) {
+            for (unsigned int x = 0; x < cells.cols; ++x) {
+                const std::size_t cell = cells.index(y, x);
+                if (cells.alpha[cell] != 0) {
+                    put(static_cast<int>(y), static_cast<int>(x), cells.glyphs[cell], cells.fg(cell), false);
+                }
+            }
         }
+        for_each_glyph(context, true, put);
+    } else {
+        for_each_glyph(context, false, put);
     }
 
     ncplane_off_styles(context.root_plane, NCSTYLE_BOLD);
 }
 
+bool RainEffect::record(const Context& context, DrawList& list) {
+    ensure_initialized(context);
+    const uint8_t lead_alpha = color::decode_alpha(lead_color_);
+    const uint8_t tail_alpha = color::decode_alpha(tail_color_);
+    const auto emit = [&](int y, int x, char32_t glyph, color::Rgb fg, bool bold) {
+        list.cell(y, x, glyph, fg, bold ? NCSTYLE_BOLD : 0U, bold ? lead_alpha : tail_alpha);
+    };
+    if (config_.phosphor && !seeking(context)) {
+        // The fading cells go in as one surface; only the heads are
+        // recorded per stream.
+        phosphor_.shade(color::decode_rgba(tail_color_), tail_alpha, context.output.fadeLevels);
+        list.surface(phosphor_.surface());
+        for_each_glyph(context, true, emit);
+    } else {
+        for_each_glyph(context, false, emit);
+    }
+    return true;
+}
+
 bool RainEffect::isFinished() const {
     if (config_.duration <= 0.0f) {
         return false;
     }
 
-    const auto now = std::chrono::steady_clock::now();
-    const float elapsed = std::chrono::duration<float>(now - start_time_).count();
-    return elapsed >= config_.duration;
+    return elapsed_ >= config_.duration;
 }
 
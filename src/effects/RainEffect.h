@@ -1,12 +1,37 @@
 #pragma once
 
+#include "effects/PhosphorBuffer.h"
+#include "effects/StreamPool.h"
 #include "engine/Effect.h"
+#include "utils/AliasTable.h"
+#include "utils/Curve.h"
 
-#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
 #include <string>
 #include <vector>
 
+// Keyframed overrides for RainConfig fields, evaluated every frame against
+// the effect's running time. Empty curves leave the fixed value in place.
+struct RainCurves {
+    Curve density{};
+    Curve minSpeed{};
+    Curve maxSpeed{};
+    Curve slantAngle{};
+    ColorCurve leadCharColor{};
+    ColorCurve tailColor{};
+};
+
+// A loaded character set and the table its glyphs are drawn from. Effects
+// made from the same RainConfig share one, so many small rain panes cost no
+// more glyph memory than one.
+struct GlyphSet {
+    std::vector<char32_t> glyphs{};
+    AliasTable table{};
+};
+
 struct RainConfig {
     // The angle of the rain in degrees. 0 is vertical.
     float slantAngle{0.0f};
@@ -19,24 +44,55 @@ struct RainConfig {
     int maxLength{20};
     float density{0.5f}; // New: Controls the number of streams relative to terminal width
 
-    std::string characterSetFile{"katakana.txt"};
+    // A UTF-8 text file, or "builtin:<name>" for a set compiled in from
+    // assets/chars/.
+    std::string characterSetFile{"builtin:katakana"};
     uint32_t leadCharColor{0xFFFFFFFF};
     uint32_t tailColor{0x00FF00FF};
 
     std::vector<char32_t> characterSet{};
+    // Relative odds of each characterSet glyph; empty when all are equal.
+    std::vector<float> characterWeights{};
+    // The loaded set, once share_glyph_set() has moved it here; copies of the
+    // config made afterwards share it.
+    std::shared_ptr<const GlyphSet> glyphSet{};
+    // Only the plain rain animation applies these.
+    RainCurves curves{};
+    // Phosphor mode: heads leave their glyphs in the cells they pass, where
+    // they fade out over `phosphorDecay` seconds, instead of every trail
+    // being redrawn each frame. 0 fades over the time an average stream takes
+    // to fall its own average length.
+    bool phosphor{false};
+    float phosphorDecay{0.0f};
+
+    // How strongly a playing soundtrack drives the rain, 0 to 1: overall
+    // loudness thins out the streams, bass scales their speed around the
+    // configured range, and treble sets the lead glyph brightness.
+    float audioDensity{0.6f};
+    float audioSpeed{0.5f};
+    float audioBrightness{0.7f};
 };
 
-struct RainStream {
-    float x{0.0f};
-    float y{0.0f};
-    float speed{0.0f};
-    int length{0};
-    int maxLength{0};
-    bool markedForReset{false};
-    std::vector<char32_t> characters{};
-    bool hasLeadChar{true};
+// Per-frame multipliers from Context::audio; all 1 without an audio source.
+struct AudioResponse {
+    float density{1.0f};
+    float speed{1.0f};
+    float brightness{1.0f};
 };
 
+AudioResponse audio_response(const RainConfig& config, const Context& context);
+
+// Fills config.characterSet from characterSetFile unless it is already set,
+// falling back to ASCII letters and digits when nothing can be loaded. In a
+// file, a line may end in a tab and a weight: its glyphs are then drawn that
+// many times as often as glyphs on lines without one.
+void load_character_set(RainConfig& config);
+// Sets the glyphs and their weights, keeping no weights if all are equal.
+void set_character_set(RainConfig& config, std::span<const char32_t> glyphs, std::span<const float> weights);
+// Loads the character set unless config.glyphSet is already set, and moves it
+// there with its sampling table. Returns config.glyphSet.
+std::shared_ptr<const GlyphSet> share_glyph_set(RainConfig& config);
+
 class RainEffect : public Effect {
 public:
     explicit RainEffect(RainConfig config);
@@ -44,17 +100,101 @@ public:
     void update(const Context& context) override;
     void render(const Context& context) override;
     bool isFinished() const override;
+    bool record(const Context& context, DrawList& list) override;
+    Footprint footprint() const override { return Footprint{streams_.size(), streams_.footprint() + phosphor_.footprint()}; }
+
+    std::unique_ptr<Effect> clone() const override { return std::make_unique<RainEffect>(*this); }
+    bool clonable() const override { return true; }
+    bool copy_to(Effect& target) const override;
+    // The phosphor glow depends on every earlier frame, so phosphor rain is
+    // replayed from snapshots instead.
+    bool seekable() const override { return !config_.phosphor; }
+    void seek(const Context& context) override;
+    // The seek cursors are not saved; seekable runs derive them from the time.
+    bool save(SnapshotWriter& out) const override;
+    bool load(SnapshotReader& in) override;
 
 private:
+    // Seekable mode: every stream slot runs through a sequence of falls, and
+    // each fall's parameters are hashed from (seed, slot, generation), so the
+    // state at any time follows from the fall in progress at that time.
+    struct LifeCursor {
+        float spawn{0.0f};
+        uint32_t generation{0};
+    };
+
+    struct Life {
+        float speed{0.0f};
+        float x{0.0f};
+        float y{0.0f};
+        int length{0};
+        int maxLength{0};
+        // Time the whole trail has left the screen and the next fall starts.
+        float end{0.0f};
+    };
+
+    Life life(std::size_t slot, const LifeCursor& cursor, const Context& context) const;
+    void ensure_seek_layout(const Context& context);
+    void advance_cursors(float time, const Context& context);
+    void evaluate(const Context& context);
+
+    // Sets the per-frame parameters (colors, slope, density) for `time`.
+    void apply_curves(float time);
+    void speed_range(float time, float& min_speed, float& max_speed) const;
+    float density_at(float time) const;
+    // Horizontal distance a stream of unit speed drifts between two times.
+    float drift(float from, float to) const;
+
+    // With `heads_only`, only the head of each stream (phosphor mode).
+    template <typename Emit>
+    void for_each_glyph(const Context& context, bool heads_only, Emit&& emit) const;
     void ensure_initialized(const Context& context);
-    void resetStream(RainStream& stream, const Context& context);
-    char32_t random_character(std::mt19937& rng) const;
-    void ensure_character_set_loaded();
+    bool seeking(const Context& context) const { return context.seekable && seekable(); }
+    // Phosphor mode: lights the cells the stream's head has entered since
+    // the last call.
+    void light_cells(std::size_t index, const Context& context);
+    int phosphor_column(const RainStream& stream, int rows_above, int cols) const;
+    void decay_phosphor(const Context& context, float delta);
+    std::size_t active_stream_count(const Context& context, float density) const;
+    void resetStream(std::size_t index, const Context& context);
+    // Index into the character set, as stored in the stream trails.
+    std::size_t random_glyph(std::mt19937& rng) const { return glyphs_->table.sample(rng); }
 
     RainConfig config_;
-    std::vector<RainStream> streams_{};
+    std::shared_ptr<const GlyphSet> glyphs_{};
+    StreamPool streams_{};
+    // Used only when the Context provides no engine RNG.
+    std::mt19937 fallback_rng_{};
     float x_velocity_per_unit_y_{0.0f};
-    std::chrono::steady_clock::time_point start_time_{};
+    float elapsed_{0.0f};
+
+    // tan(slantAngle) over time, integrated for the drift of seeked streams.
+    Curve slope_curve_{};
+    // Streams are laid out for the highest density the curve reaches; lower
+    // values leave the surplus parked instead of resizing.
+    float layout_density_{0.5f};
+    float density_{1.0f};
+    uint32_t lead_color_{0xFFFFFFFF};
+    uint32_t tail_color_{0x00FF00FF};
+    float lead_brightness_{1.0f};
     bool initialized_{false};
+
+    PhosphorBuffer phosphor_{};
+    // Lowest row each stream's head has lit in its current fall.
+    std::vector<int32_t> lit_rows_{};
+    // Decay owed but below one intensity step, carried to the next frame.
+    float decay_carry_{0.0f};
+
+    std::vector<LifeCursor> cursors_{};
+    // Cursors every `keyframe_interval_` seconds, `cursors_.size()` per
+    // keyframe, so seeking backwards only re-walks the falls since the last
+    // keyframe. Past kMaxKeyframes every other one is dropped and the
+    // interval doubles.
+    std::vector<LifeCursor> keyframes_{};
+    std::size_t keyframe_count_{0};
+    float keyframe_interval_{0.0f};
+    float cursor_time_{0.0f};
+    unsigned int seek_rows_{0};
+    unsigned int seek_cols_{0};
 };
 
@@ -0,0 +1,65 @@
+#include "effects/StreamPool.h"
+
+#include <algorithm>
+
+void StreamPool::reset(std::size_t count, std::size_t trail_capacity, std::size_t charset_size) {
+    trail_capacity_ = std::clamp<std::size_t>(trail_capacity, 1, RainStream::kMaxLength);
+    wide_ = charset_size > 256;
+
+    RainStream parked;
+    parked.set(RainStream::kMarkedForReset, true);
+    streams_.assign(count, parked);
+
+    const std::size_t glyphs = count * trail_capacity_;
+    if (wide_) {
+        wide_glyphs_.assign(glyphs, 0);
+        narrow_glyphs_.clear();
+        narrow_glyphs_.shrink_to_fit();
+    } else {
+        narrow_glyphs_.assign(glyphs, 0);
+        wide_glyphs_.clear();
+        wide_glyphs_.shrink_to_fit();
+    }
+}
+
+std::size_t StreamPool::footprint() const {
+    return streams_.capacity() * sizeof(RainStream) + narrow_glyphs_.capacity() * sizeof(uint8_t) +
+           wide_glyphs_.capacity() * sizeof(uint16_t);
+}
+
+void StreamPool::save(SnapshotWriter& out) const {
+    out.put<uint64_t>(trail_capacity_);
+    out.put(wide_);
+    out.put_array(streams_);
+    if (wide_) {
+        out.put_array(wide_glyphs_);
+    } else {
+        out.put_array(narrow_glyphs_);
+    }
+}
+
+bool StreamPool::load(SnapshotReader& in, std::size_t charset_size) {
+    uint64_t trail_capacity = 0;
+    bool wide = false;
+    if (!in.get(trail_capacity) || !in.get(wide) || wide != (charset_size > 256) || trail_capacity == 0 ||
+        trail_capacity > RainStream::kMaxLength || !in.get_array(streams_)) {
+        return false;
+    }
+    trail_capacity_ = static_cast<std::size_t>(trail_capacity);
+    wide_ = wide;
+    // Trails are drawn up to maxLength, and their glyphs index the
+    // character set.
+    const bool lengths_fit = std::all_of(streams_.begin(), streams_.end(), [&](const RainStream& stream) {
+        return stream.maxLength <= trail_capacity_ && stream.length <= stream.maxLength;
+    });
+    const auto glyphs_fit = [&](const auto& glyphs) {
+        return glyphs.size() == streams_.size() * trail_capacity_ &&
+               std::all_of(glyphs.begin(), glyphs.end(), [&](std::size_t glyph) { return glyph < charset_size; });
+    };
+    if (wide_) {
+        narrow_glyphs_.clear();
+        return in.get_array(wide_glyphs_) && lengths_fit && glyphs_fit(wide_glyphs_);
+    }
+    wide_glyphs_.clear();
+    return in.get_array(narrow_glyphs_) && lengths_fit && glyphs_fit(narrow_glyphs_);
+}
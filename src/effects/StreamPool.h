@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "utils/AliasTable.h"
+#include "utils/SnapshotIo.h"
+
+// One falling stream in 16 bytes, so that the stream array of a very large
+// canvas still fits in cache. Positions and speed stay full floats; lengths
+// and state are packed into the last four bytes. The trail glyphs live in the
+// StreamPool that owns the stream.
+struct RainStream {
+    enum Flag : uint16_t {
+        kMarkedForReset = 1U << 0U,
+        kLeadChar = 1U << 1U,
+        // rain_and_converge: the stream may start a new fall, or has been
+        // parked for good after its last one.
+        kAllowRespawn = 1U << 2U,
+        kInactive = 1U << 3U,
+    };
+    static constexpr int kMaxLength = (1 << 12) - 1;
+
+    float x{0.0f};
+    float y{0.0f};
+    float speed{0.0f};
+    uint16_t length{0};
+    uint16_t maxLength : 12 {0};
+    uint16_t flags : 4 {kLeadChar | kAllowRespawn};
+
+    bool has(Flag flag) const { return (flags & flag) != 0U; }
+    void set(Flag flag, bool on) { flags = on ? (flags | flag) : (flags & ~flag); }
+};
+
+static_assert(sizeof(RainStream) == 16, "RainStream should stay packed");
+
+// Fixed set of streams with every trail in one shared array. Trails hold
+// indices into the character set rather than code points: one byte per glyph
+// for sets of up to 256 characters and two beyond that. Sizing the pool with
+// reset() is the only call that allocates.
+class StreamPool {
+public:
+    // Character sets are cut to this size when loaded.
+    static constexpr std::size_t kMaxCharset = 1U << 16U;
+
+    // `count` streams with room for `trail_capacity` glyphs each, all marked
+    // for reset.
+    void reset(std::size_t count, std::size_t trail_capacity, std::size_t charset_size);
+
+    std::size_t size() const { return streams_.size(); }
+    bool empty() const { return streams_.empty(); }
+    std::size_t trail_capacity() const { return trail_capacity_; }
+    // Whether trails hold two-byte indices; see trail().
+    bool wide() const { return wide_; }
+
+    RainStream& operator[](std::size_t index) { return streams_[index]; }
+    const RainStream& operator[](std::size_t index) const { return streams_[index]; }
+    auto begin() { return streams_.begin(); }
+    auto end() { return streams_.end(); }
+    auto begin() const { return streams_.begin(); }
+    auto end() const { return streams_.end(); }
+
+    std::size_t glyph(std::size_t stream, std::size_t index) const {
+        const std::size_t at = stream * trail_capacity_ + index;
+        return wide_ ? wide_glyphs_[at] : narrow_glyphs_[at];
+    }
+    void set_glyph(std::size_t stream, std::size_t index, std::size_t glyph) {
+        const std::size_t at = stream * trail_capacity_ + index;
+        if (wide_) {
+            wide_glyphs_[at] = static_cast<uint16_t>(glyph);
+        } else {
+            narrow_glyphs_[at] = static_cast<uint8_t>(glyph);
+        }
+    }
+
+    // Draws the first `count` glyphs of a stream's trail from `glyphs`.
+    void fill_trail(std::size_t stream, std::size_t count, const AliasTable& glyphs, std::mt19937& rng) {
+        const std::size_t at = stream * trail_capacity_;
+        if (wide_) {
+            glyphs.fill(wide_glyphs_.data() + at, count, rng);
+        } else {
+            glyphs.fill(narrow_glyphs_.data() + at, count, rng);
+        }
+    }
+
+    // One stream's trail indices. `Index` must match wide(): uint16_t for
+    // wide pools, uint8_t otherwise.
+    template <typename Index>
+    const Index* trail(std::size_t stream) const {
+        if constexpr (std::is_same_v<Index, uint16_t>) {
+            return wide_glyphs_.data() + stream * trail_capacity_;
+        } else {
+            return narrow_glyphs_.data() + stream * trail_capacity_;
+        }
+    }
+
+    // Bytes held by the streams and their trails.
+    std::size_t footprint() const;
+
+    // Warm start. load() replaces the pool and fails if a trail is longer
+    // than the trail capacity or holds an index outside a character set of
+    // `charset_size` glyphs.
+    void save(SnapshotWriter& out) const;
+    bool load(SnapshotReader& in, std::size_t charset_size);
+
+private:
+    std::vector<RainStream> streams_{};
+    std::vector<uint8_t> narrow_glyphs_{};
+    std::vector<uint16_t> wide_glyphs_{};
+    std::size_t trail_capacity_{0};
+    bool wide_{false};
+};
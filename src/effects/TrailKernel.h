@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "utils/Color.h"
+
+// Trail drawing shared by the glyph rain effects. The inner loop is
+// instantiated per frame for what cannot change within it: whether the rain
+// is slanted and how trail glyphs are stored. Vertical trails then work out
+// and wrap their column once instead of per glyph, and clipping is folded
+// into the loop bounds.
+namespace trail_kernel {
+
+// Values fixed for every trail of a frame.
+struct Frame {
+    color::Rgb lead{};
+    color::Rgb tail{};
+    // Columns a trail moves left per row above its head.
+    float slope{0.0f};
+    int rows{0};
+    int cols{0};
+    int fadeLevels{0};
+};
+
+// A StreamPool trail of character-set indices, read as code points.
+template <typename Index>
+struct IndexedGlyphs {
+    const Index* indices;
+    const char32_t* charset;
+
+    char32_t operator[](std::size_t i) const { return charset[indices[i]]; }
+};
+
+// Wraps `x` onto the screen; false when there are no columns.
+inline bool wrap_column(int& x, int cols) {
+    if (cols <= 0) {
+        return false;
+    }
+    while (x < 0) {
+        x += cols;
+    }
+    while (x >= cols) {
+        x -= cols;
+    }
+    return true;
+}
+
+// Emits up to `count` glyphs upward from the head, leaving out rows off the
+// screen and rows at or below `clip_y`. The tail fades over `fade_length`
+// glyphs; the head uses the lead color when `has_lead` is set.
+template <bool Slanted, typename Glyphs, typename Emit>
+void draw(const Frame& frame, float head_x, float head_y, const Glyphs& glyphs, int count, int fade_length,
+          bool has_lead, int clip_y, Emit&& emit) {
+    // Glyph i sits on row head_row - i, which must lie in [0, bottom).
+    const int head_row = static_cast<int>(head_y);
+    const int bottom = std::min(frame.rows, clip_y);
+    const int first = std::max(0, head_row - bottom + 1);
+    const int last = std::min(count, head_row + 1);
+    if (first >= last) {
+        return;
+    }
+
+    int column = static_cast<int>(std::round(head_x));
+    if constexpr (!Slanted) {
+        if (!wrap_column(column, frame.cols)) {
+            return;
+        }
+    }
+    const auto column_of = [&](int i, int& x) {
+        if constexpr (Slanted) {
+            x = static_cast<int>(std::round(head_x - static_cast<float>(i) * frame.slope));
+            return wrap_column(x, frame.cols);
+        } else {
+            x = column;
+            return true;
+        }
+    };
+
+    int i = first;
+    int x = 0;
+    if (i == 0 && has_lead) {
+        if (column_of(0, x)) {
+            emit(head_row, x, glyphs[0], frame.lead, true);
+        }
+        i = 1;
+    }
+    const int fade_span = std::max(1, fade_length - 1);
+    for (; i < last; ++i) {
+        if (!column_of(i, x)) {
+            continue;
+        }
+        const float t = static_cast<float>(i) / fade_span;
+        emit(head_row - i, x, glyphs[static_cast<std::size_t>(i)],
+             color::scale(frame.tail, color::quantize(1.0f - t, frame.fadeLevels)), false);
+    }
+}
+
+// Calls `body(slanted, index)` once, with std::bool_constant and a value of
+// the trail index type, so each frame picks its kernel with one branch.
+template <typename Body>
+void dispatch(bool slanted, bool wide, Body&& body) {
+    if (slanted) {
+        if (wide) {
+            body(std::true_type{}, uint16_t{});
+        } else {
+            body(std::true_type{}, uint8_t{});
+        }
+    } else if (wide) {
+        body(std::false_type{}, uint16_t{});
+    } else {
+        body(std::false_type{}, uint8_t{});
+    }
+}
+
+} // namespace trail_kernel
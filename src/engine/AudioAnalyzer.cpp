@@ -0,0 +1,396 @@
+#include "AudioAnalyzer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+constexpr float kLowestBandHz = 40.0f;
+constexpr float kHighestBandHz = 16000.0f;
+// Energies are scaled to 0..1 over this many dB below a running peak, which
+// falls slowly so quiet passages regain detail.
+constexpr float kDynamicRangeDb = 48.0f;
+constexpr float kPeakFallDbPerSecond = 3.0f;
+constexpr float kPeakFloorDb = -70.0f;
+// Time constant for levels to fall back after a beat.
+constexpr float kReleaseSeconds = 0.2f;
+constexpr int kPollTimeoutMs = 100;
+
+std::uint16_t read_u16(const std::uint8_t* bytes) {
+    return static_cast<std::uint16_t>(bytes[0] | (bytes[1] << 8U));
+}
+
+std::uint32_t read_u32(const std::uint8_t* bytes) {
+    return static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8U) |
+           (static_cast<std::uint32_t>(bytes[2]) << 16U) | (static_cast<std::uint32_t>(bytes[3]) << 24U);
+}
+
+float decibels(float power) {
+    return 10.0f * std::log10(power + 1e-12f);
+}
+
+float normalize(float db, float& peak, float fall) {
+    peak = std::max({db, peak - fall, kPeakFloorDb});
+    return std::clamp((db - peak + kDynamicRangeDb) / kDynamicRangeDb, 0.0f, 1.0f);
+}
+} // namespace
+
+AudioAnalyzer::AudioAnalyzer(AudioConfig config) : config_(std::move(config)) {
+    std::fill(std::begin(band_peaks_), std::end(band_peaks_), -60.0f);
+}
+
+AudioAnalyzer::~AudioAnalyzer() {
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool AudioAnalyzer::start(std::string& error) {
+    struct stat info {};
+    if (::stat(config_.source.c_str(), &info) != 0) {
+        error = "cannot open '" + config_.source + "': " + std::strerror(errno);
+        return false;
+    }
+
+    // A pipe is opened read-write so that opening does not wait for a writer
+    // and a writer coming and going is not seen as the end of the stream.
+    const bool fifo = S_ISFIFO(info.st_mode);
+    fd_ = ::open(config_.source.c_str(), (fifo ? O_RDWR : O_RDONLY) | O_NONBLOCK);
+    if (fd_ < 0) {
+        error = "cannot open '" + config_.source + "': " + std::strerror(errno);
+        return false;
+    }
+    file_ = !fifo;
+    sample_rate_ = config_.sampleRate;
+    channels_ = config_.channels;
+
+    // A file's header is read now so format errors are reported up front; a
+    // pipe may not have produced one yet.
+    if (!fifo && !read_header(error)) {
+        return false;
+    }
+
+    // Everything the analysis needs is allocated before the render loop
+    // starts, so the thread adds nothing to the per-frame heap traffic. A
+    // pipe's header is only read on the thread, so raw_ has room for the
+    // widest frame a header may announce.
+    prepare_tables();
+    raw_.reserve(kHop * kMaxChannels * 4U);
+    pending_.reserve(4);
+
+    thread_ = std::thread([this, fifo] {
+        std::string ignored;
+        if (!fifo || read_header(ignored)) {
+            run();
+        }
+        finished_ = true;
+    });
+    return true;
+}
+
+void AudioAnalyzer::prepare_tables() {
+    samples_.assign(kWindow, 0.0f);
+    spectrum_.assign(kWindow, {});
+    hann_.resize(kWindow);
+    twiddles_.resize(kWindow / 2);
+    bit_reverse_.resize(kWindow);
+    const float two_pi = 2.0f * std::numbers::pi_v<float>;
+    std::size_t bits = 0;
+    while ((std::size_t{1} << bits) < kWindow) {
+        ++bits;
+    }
+    for (std::size_t i = 0; i < kWindow; ++i) {
+        hann_[i] = 0.5f - 0.5f * std::cos(two_pi * static_cast<float>(i) / static_cast<float>(kWindow - 1));
+        std::size_t reversed = 0;
+        for (std::size_t bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1U) << (bits - 1 - bit);
+        }
+        bit_reverse_[i] = reversed;
+    }
+    for (std::size_t k = 0; k < kWindow / 2; ++k) {
+        twiddles_[k] = std::polar(1.0f, -two_pi * static_cast<float>(k) / static_cast<float>(kWindow));
+    }
+}
+
+bool AudioAnalyzer::read_exact(void* buffer, std::size_t size) {
+    auto* out = static_cast<std::uint8_t*>(buffer);
+    const std::size_t from_pending = std::min(size, pending_.size());
+    std::copy_n(pending_.begin(), from_pending, out);
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(from_pending));
+
+    std::size_t done = from_pending;
+    while (done < size) {
+        if (stop_) {
+            return false;
+        }
+        pollfd descriptor{fd_, POLLIN, 0};
+        const int ready = ::poll(&descriptor, 1, kPollTimeoutMs);
+        if (ready == 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+        }
+        const ssize_t count = ::read(fd_, out + done, size - done);
+        if (count > 0) {
+            done += static_cast<std::size_t>(count);
+        } else if (count == 0) {
+            return false;
+        } else if (errno != EAGAIN && errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AudioAnalyzer::read_header(std::string& error) {
+    std::uint8_t riff[12];
+    if (!read_exact(riff, 4)) {
+        error = "'" + config_.source + "' is empty";
+        return false;
+    }
+    if (std::memcmp(riff, "RIFF", 4) != 0) {
+        // Raw PCM: the bytes already read are the first samples.
+        pending_.assign(riff, riff + 4);
+        bits_ = 16;
+        float_samples_ = false;
+        return true;
+    }
+    if (!read_exact(riff + 4, 8) || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        error = "'" + config_.source + "' is not a WAV file";
+        return false;
+    }
+
+    long long offset = 12;
+    bool have_format = false;
+    // Only the start of a chunk is kept, which covers every field of the
+    // fmt chunk; the rest is read through `skipped` and dropped.
+    std::uint8_t chunk[64];
+    std::uint8_t skipped[256];
+    while (true) {
+        std::uint8_t header[8];
+        if (!read_exact(header, sizeof(header))) {
+            error = "'" + config_.source + "' has no data chunk";
+            return false;
+        }
+        offset += 8;
+        const std::uint32_t size = read_u32(header + 4);
+        if (std::memcmp(header, "data", 4) == 0) {
+            // Streamed WAVs often leave the size at 0 or the maximum.
+            if (size != 0 && size != 0xFFFFFFFFU) {
+                data_size_ = size;
+            }
+            break;
+        }
+
+        // Chunks are padded to an even size.
+        std::uint64_t left = std::uint64_t{size} + (size & 1U);
+        const std::size_t kept = static_cast<std::size_t>(std::min<std::uint64_t>(left, sizeof(chunk)));
+        bool complete = read_exact(chunk, kept);
+        left -= kept;
+        while (complete && left > 0) {
+            const std::size_t piece = static_cast<std::size_t>(std::min<std::uint64_t>(left, sizeof(skipped)));
+            complete = read_exact(skipped, piece);
+            left -= piece;
+        }
+        if (!complete) {
+            error = "'" + config_.source + "' is truncated";
+            return false;
+        }
+        offset += static_cast<long long>(size) + (size & 1U);
+        if (std::memcmp(header, "fmt ", 4) == 0 && size >= 16) {
+            std::uint16_t format = read_u16(chunk);
+            channels_ = read_u16(chunk + 2);
+            sample_rate_ = read_u32(chunk + 4);
+            bits_ = read_u16(chunk + 14);
+            if (format == 0xFFFE && size >= 26) {
+                format = read_u16(chunk + 24);
+            }
+            float_samples_ = format == 3;
+            have_format = (format == 1 && (bits_ == 8 || bits_ == 16 || bits_ == 24 || bits_ == 32)) ||
+                          (format == 3 && bits_ == 32);
+            if (!have_format) {
+                error = "'" + config_.source + "' uses an unsupported sample format";
+                return false;
+            }
+            if (channels_ > kMaxChannels) {
+                error = "'" + config_.source + "' has more than " + std::to_string(kMaxChannels) + " channels";
+                return false;
+            }
+        }
+    }
+
+    if (!have_format || channels_ == 0 || sample_rate_ == 0) {
+        error = "'" + config_.source + "' has no usable format chunk";
+        return false;
+    }
+    data_offset_ = ::lseek(fd_, 0, SEEK_CUR) == offset ? offset : -1;
+    data_remaining_ = data_size_;
+    return true;
+}
+
+bool AudioAnalyzer::read_hop() {
+    const std::size_t frame_bytes = static_cast<std::size_t>(channels_) * (bits_ / 8U);
+    raw_.resize(kHop * frame_bytes);
+    if (data_remaining_ < raw_.size() || !read_exact(raw_.data(), raw_.size())) {
+        // Partial hops at the end are dropped; a loop starts over cleanly.
+        if (!config_.loop || data_offset_ < 0 || stop_ || ::lseek(fd_, data_offset_, SEEK_SET) != data_offset_) {
+            return false;
+        }
+        data_remaining_ = data_size_;
+        if (data_remaining_ < raw_.size() || !read_exact(raw_.data(), raw_.size())) {
+            return false;
+        }
+    }
+    data_remaining_ -= raw_.size();
+
+    // Slide the window by one hop and append the new samples mixed to mono.
+    std::copy(samples_.begin() + kHop, samples_.end(), samples_.begin());
+    float* out = samples_.data() + (kWindow - kHop);
+    const std::uint8_t* in = raw_.data();
+    const float scale = 1.0f / static_cast<float>(channels_);
+    for (std::size_t i = 0; i < kHop; ++i) {
+        float sum = 0.0f;
+        for (unsigned int channel = 0; channel < channels_; ++channel) {
+            if (float_samples_) {
+                float value = 0.0f;
+                std::memcpy(&value, in, sizeof(value));
+                sum += value;
+            } else if (bits_ == 8) {
+                sum += (static_cast<float>(in[0]) - 128.0f) / 128.0f;
+            } else if (bits_ == 16) {
+                sum += static_cast<float>(static_cast<std::int16_t>(read_u16(in))) / 32768.0f;
+            } else if (bits_ == 24) {
+                const std::uint32_t packed = in[0] | (in[1] << 8U) | (static_cast<std::uint32_t>(in[2]) << 16U);
+                sum += static_cast<float>(static_cast<std::int32_t>(packed << 8U) >> 8) / 8388608.0f;
+            } else {
+                sum += static_cast<float>(static_cast<std::int32_t>(read_u32(in))) / 2147483648.0f;
+            }
+            in += bits_ / 8U;
+        }
+        out[i] = sum * scale;
+    }
+    samples_read_ += kHop;
+    return true;
+}
+
+void AudioAnalyzer::analyze() {
+    // Windowed, bit-reversed copy, then an iterative radix-2 FFT in place.
+    for (std::size_t i = 0; i < kWindow; ++i) {
+        spectrum_[bit_reverse_[i]] = std::complex<float>(samples_[i] * hann_[i], 0.0f);
+    }
+    for (std::size_t length = 2; length <= kWindow; length <<= 1U) {
+        const std::size_t half = length / 2;
+        const std::size_t stride = kWindow / length;
+        for (std::size_t start = 0; start < kWindow; start += length) {
+            for (std::size_t j = 0; j < half; ++j) {
+                const std::complex<float> even = spectrum_[start + j];
+                const std::complex<float> odd = spectrum_[start + j + half] * twiddles_[j * stride];
+                spectrum_[start + j] = even + odd;
+                spectrum_[start + j + half] = even - odd;
+            }
+        }
+    }
+
+    const float hop_seconds = static_cast<float>(kHop) / static_cast<float>(sample_rate_);
+    const float fall = kPeakFallDbPerSecond * hop_seconds;
+    Frame frame;
+    frame.time = static_cast<float>(static_cast<double>(samples_read_) / sample_rate_);
+    for (int band = 0; band < AudioLevels::kBands; ++band) {
+        float power = 0.0f;
+        for (std::size_t bin = band_edges_[band]; bin < band_edges_[band + 1]; ++bin) {
+            power += std::norm(spectrum_[bin]);
+        }
+        power /= static_cast<float>(band_edges_[band + 1] - band_edges_[band]);
+        frame.bands[band] = normalize(decibels(power), band_peaks_[band], fall);
+    }
+    float mean_square = 0.0f;
+    for (const float sample : samples_) {
+        mean_square += sample * sample;
+    }
+    frame.level = normalize(decibels(mean_square / static_cast<float>(kWindow)), level_peak_, fall);
+
+    // A full ring means the audio is well ahead of the scene clock; wait for
+    // the consumer rather than drop frames it will still need.
+    while (!ring_.try_push(frame)) {
+        if (stop_) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+void AudioAnalyzer::run() {
+    // Log-spaced band edges as FFT bins, at least one bin per band.
+    const float nyquist = static_cast<float>(sample_rate_) / 2.0f;
+    const float highest = std::min(kHighestBandHz, nyquist);
+    const float bin_hz = static_cast<float>(sample_rate_) / static_cast<float>(kWindow);
+    band_edges_[0] = std::max<std::size_t>(1, static_cast<std::size_t>(kLowestBandHz / bin_hz));
+    for (int band = 1; band <= AudioLevels::kBands; ++band) {
+        const float hz = kLowestBandHz * std::pow(highest / kLowestBandHz, static_cast<float>(band) / AudioLevels::kBands);
+        const auto bin = static_cast<std::size_t>(std::lround(hz / bin_hz));
+        band_edges_[band] = std::min(kWindow / 2, std::max(band_edges_[band - 1] + 1, bin));
+    }
+
+    while (!stop_ && read_hop()) {
+        analyze();
+    }
+}
+
+void AudioAnalyzer::poll(float time, float delta, AudioLevels& levels, bool catch_up) {
+    bool fresh = false;
+    Frame frame;
+    while (true) {
+        const Frame* next = ring_.front();
+        if (next == nullptr) {
+            if (!catch_up || !file_ || finished_) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        if (next->time > time) {
+            break;
+        }
+        frame = *next;
+        ring_.pop();
+        fresh = true;
+    }
+
+    const float release = std::exp(-std::max(0.0f, delta) / kReleaseSeconds);
+    levels.active = true;
+    levels.level *= release;
+    for (float& band : levels.bands) {
+        band *= release;
+    }
+    if (fresh) {
+        levels.level = std::max(levels.level, frame.level);
+        for (int band = 0; band < AudioLevels::kBands; ++band) {
+            levels.bands[band] = std::max(levels.bands[band], frame.bands[band]);
+        }
+        last_frame_time_ = frame.time;
+        has_frame_ = true;
+    }
+    levels.bass = (levels.bands[0] + levels.bands[1]) / 2.0f;
+    levels.mid = (levels.bands[2] + levels.bands[3] + levels.bands[4]) / 3.0f;
+    levels.treble = (levels.bands[5] + levels.bands[6] + levels.bands[7]) / 3.0f;
+
+    // Staleness of the analysis in use; once the source has ended there is
+    // nothing left to be in sync with.
+    if (has_frame_ && !(finished_ && ring_.front() == nullptr)) {
+        const float lag = time - last_frame_time_;
+        sync_.frames++;
+        sync_.lagSum += lag;
+        sync_.lagMax = std::max(sync_.lagMax, lag);
+    }
+}
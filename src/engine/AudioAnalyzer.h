@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Context.h"
+#include "utils/SpscRing.h"
+
+struct AudioConfig {
+    // WAV file, or a named pipe carrying a WAV stream or raw PCM. Empty
+    // disables audio.
+    std::string source{};
+    // Format of raw PCM (signed 16-bit little endian) without a WAV header.
+    unsigned int sampleRate{44100};
+    unsigned int channels{2};
+    // Start a file over when it ends.
+    bool loop{false};
+};
+
+// Streams PCM from a WAV file or pipe on a background thread and turns it into
+// band energies with a windowed FFT. Each analysis frame is stamped with its
+// position in the audio and handed over through a lock-free ring; the Engine
+// consumes the frames whose time the scene clock has reached.
+class AudioAnalyzer {
+public:
+    explicit AudioAnalyzer(AudioConfig config);
+    ~AudioAnalyzer();
+
+    AudioAnalyzer(const AudioAnalyzer&) = delete;
+    AudioAnalyzer& operator=(const AudioAnalyzer&) = delete;
+
+    // Opens the source, reads the WAV header if there is one, and starts the
+    // analysis thread.
+    bool start(std::string& error);
+
+    // Applies the newest frames at or before `time` to `levels`, letting
+    // them decay over `delta` seconds when nothing new arrived. Never blocks,
+    // unless `catch_up` is set and the source is a file: then it waits for
+    // the analysis to reach `time`, so a fixed-step run that renders faster
+    // than real time still sees the audio that belongs to each frame.
+    void poll(float time, float delta, AudioLevels& levels, bool catch_up);
+
+    // Scene time minus the time of the frame in use, over all polls.
+    struct SyncStats {
+        std::uint64_t frames{0};
+        double lagSum{0.0};
+        float lagMax{0.0f};
+    };
+    const SyncStats& sync_stats() const { return sync_; }
+
+private:
+    static constexpr std::size_t kWindow = 1024;
+    static constexpr std::size_t kHop = kWindow / 2;
+    static constexpr std::size_t kRingFrames = 256;
+    // Same limit as `channels` in the config; WAV headers asking for more
+    // are rejected.
+    static constexpr unsigned int kMaxChannels = 8;
+
+    struct Frame {
+        float time{0.0f};
+        float level{0.0f};
+        float bands[AudioLevels::kBands]{};
+    };
+
+    void prepare_tables();
+    bool read_header(std::string& error);
+    bool read_exact(void* buffer, std::size_t size);
+    bool read_hop();
+    void analyze();
+    void run();
+
+    AudioConfig config_;
+    int fd_{-1};
+    bool file_{false};
+    unsigned int sample_rate_{44100};
+    unsigned int channels_{2};
+    unsigned int bits_{16};
+    bool float_samples_{false};
+    // Byte offset of the sample data, for looping; -1 when not seekable.
+    long long data_offset_{-1};
+    // Size of the WAV data chunk, when the header states one, and what is
+    // left of it.
+    std::uint64_t data_size_{UINT64_MAX};
+    std::uint64_t data_remaining_{UINT64_MAX};
+    // Bytes read before the format was known that belong to the samples.
+    std::vector<std::uint8_t> pending_{};
+
+    std::vector<std::uint8_t> raw_{};
+    std::vector<float> samples_{};
+    std::vector<float> hann_{};
+    std::vector<std::complex<float>> spectrum_{};
+    std::vector<std::complex<float>> twiddles_{};
+    std::vector<std::size_t> bit_reverse_{};
+    std::size_t band_edges_[AudioLevels::kBands + 1]{};
+    float band_peaks_[AudioLevels::kBands]{};
+    float level_peak_{-60.0f};
+    std::uint64_t samples_read_{0};
+
+    SpscRing<Frame, kRingFrames> ring_{};
+    std::thread thread_{};
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> finished_{false};
+    // Consumer side only.
+    float last_frame_time_{0.0f};
+    bool has_frame_{false};
+    SyncStats sync_{};
+};
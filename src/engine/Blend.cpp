@@ -0,0 +1,164 @@
+#include "Blend.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr uint8_t kGlyphTakeover = 128;
+
+// Effective source weight: opaque over an empty cell, zero for an empty source.
+inline unsigned effective_alpha(uint8_t src_alpha, uint8_t dst_alpha) {
+    if (src_alpha == 0) {
+        return 0;
+    }
+    return dst_alpha == 0 ? 255U : src_alpha;
+}
+
+inline uint8_t mix(uint8_t dst, uint8_t src, unsigned weight) {
+    const unsigned value = dst * (255U - weight) + src * weight + 128U;
+    return static_cast<uint8_t>((value + (value >> 8U)) >> 8U);
+}
+
+inline uint8_t union_alpha(uint8_t dst, uint8_t src) {
+    const unsigned overlap = dst * src + 128U;
+    return static_cast<uint8_t>(src + dst - ((overlap + (overlap >> 8U)) >> 8U));
+}
+
+void blend_colors_scalar(Framebuffer& dst, const Framebuffer& src, std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+        const unsigned weight = effective_alpha(src.alpha[i], dst.alpha[i]);
+        dst.r[i] = mix(dst.r[i], src.r[i], weight);
+        dst.g[i] = mix(dst.g[i], src.g[i], weight);
+        dst.b[i] = mix(dst.b[i], src.b[i], weight);
+    }
+}
+
+#if defined(__SSE2__)
+// (d * (255 - w) + s * w) / 255 on eight 16-bit lanes, rounded.
+inline __m128i mix_epi16(__m128i dst, __m128i src, __m128i weight) {
+    const __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), weight);
+    __m128i value = _mm_add_epi16(_mm_mullo_epi16(dst, inverse), _mm_mullo_epi16(src, weight));
+    value = _mm_add_epi16(value, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+}
+
+inline __m128i mix_epi8(__m128i dst, __m128i src, __m128i weight_lo, __m128i weight_hi) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = mix_epi16(_mm_unpacklo_epi8(dst, zero), _mm_unpacklo_epi8(src, zero), weight_lo);
+    const __m128i hi = mix_epi16(_mm_unpackhi_epi8(dst, zero), _mm_unpackhi_epi8(src, zero), weight_hi);
+    return _mm_packus_epi16(lo, hi);
+}
+
+std::size_t blend_colors_sse2(Framebuffer& dst, const Framebuffer& src, std::size_t begin, std::size_t end) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi8(static_cast<char>(0xFF));
+    std::size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        const __m128i src_alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.alpha.data() + i));
+        const __m128i dst_alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst.alpha.data() + i));
+
+        // weight = src_alpha == 0 ? 0 : (dst_alpha == 0 ? 255 : src_alpha)
+        const __m128i dst_empty = _mm_cmpeq_epi8(dst_alpha, zero);
+        __m128i weight = _mm_or_si128(_mm_and_si128(dst_empty, opaque), _mm_andnot_si128(dst_empty, src_alpha));
+        weight = _mm_andnot_si128(_mm_cmpeq_epi8(src_alpha, zero), weight);
+        const __m128i weight_lo = _mm_unpacklo_epi8(weight, zero);
+        const __m128i weight_hi = _mm_unpackhi_epi8(weight, zero);
+
+        uint8_t* planes[3] = {dst.r.data() + i, dst.g.data() + i, dst.b.data() + i};
+        const uint8_t* sources[3] = {src.r.data() + i, src.g.data() + i, src.b.data() + i};
+        for (int channel = 0; channel < 3; ++channel) {
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[channel]));
+            const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sources[channel]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[channel]), mix_epi8(d, s, weight_lo, weight_hi));
+        }
+    }
+    return i;
+}
+
+// Sixteen cells per step; runs without a single non-empty source cell, the
+// common case for sparse surfaces, are skipped after one compare.
+std::size_t copy_over_sse2(Framebuffer& dst, std::size_t dst_begin, const Framebuffer& src, std::size_t src_begin,
+                           std::size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const std::size_t d = dst_begin + i;
+        const std::size_t s = src_begin + i;
+        const __m128i src_alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.alpha.data() + s));
+        const __m128i empty = _mm_cmpeq_epi8(src_alpha, zero);
+        if (_mm_movemask_epi8(empty) == 0xFFFF) {
+            continue;
+        }
+
+        uint8_t* planes[5] = {dst.r.data() + d, dst.g.data() + d, dst.b.data() + d, dst.styles.data() + d, dst.alpha.data() + d};
+        const uint8_t* sources[5] = {src.r.data() + s, src.g.data() + s, src.b.data() + s, src.styles.data() + s,
+                                     src.alpha.data() + s};
+        for (int plane = 0; plane < 5; ++plane) {
+            const __m128i below = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes[plane]));
+            const __m128i above = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sources[plane]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[plane]),
+                             _mm_or_si128(_mm_and_si128(empty, below), _mm_andnot_si128(empty, above)));
+        }
+
+        // Widen the per-cell mask to the four-byte glyphs.
+        const __m128i empty_lo = _mm_unpacklo_epi8(empty, empty);
+        const __m128i empty_hi = _mm_unpackhi_epi8(empty, empty);
+        const __m128i masks[4] = {_mm_unpacklo_epi16(empty_lo, empty_lo), _mm_unpackhi_epi16(empty_lo, empty_lo),
+                                  _mm_unpacklo_epi16(empty_hi, empty_hi), _mm_unpackhi_epi16(empty_hi, empty_hi)};
+        for (int part = 0; part < 4; ++part) {
+            auto* d_ptr = reinterpret_cast<__m128i*>(dst.glyphs.data() + d + static_cast<std::size_t>(part) * 4);
+            const auto* s_ptr = reinterpret_cast<const __m128i*>(src.glyphs.data() + s + static_cast<std::size_t>(part) * 4);
+            const __m128i below = _mm_loadu_si128(d_ptr);
+            const __m128i above = _mm_loadu_si128(s_ptr);
+            _mm_storeu_si128(d_ptr, _mm_or_si128(_mm_and_si128(masks[part], below), _mm_andnot_si128(masks[part], above)));
+        }
+    }
+    return i;
+}
+#endif
+} // namespace
+
+void blend_over(Framebuffer& dst, const Framebuffer& src) {
+    blend_over(dst, src, 0, dst.size());
+}
+
+void blend_over(Framebuffer& dst, const Framebuffer& src, std::size_t begin, std::size_t end) {
+    std::size_t done = begin;
+#if defined(__SSE2__)
+    done = blend_colors_sse2(dst, src, begin, end);
+#endif
+    blend_colors_scalar(dst, src, done, end);
+
+    // Glyph, style and coverage use plain selects the compiler can vectorize.
+    for (std::size_t i = begin; i < end; ++i) {
+        const uint8_t src_alpha = src.alpha[i];
+        const uint8_t dst_alpha = dst.alpha[i];
+        const bool take_source = src_alpha != 0 && (dst_alpha == 0 || src_alpha >= kGlyphTakeover);
+        dst.glyphs[i] = take_source ? src.glyphs[i] : dst.glyphs[i];
+        dst.styles[i] = take_source ? src.styles[i] : dst.styles[i];
+        dst.alpha[i] = union_alpha(dst_alpha, src_alpha);
+    }
+}
+
+void copy_over(Framebuffer& dst, std::size_t dst_begin, const Framebuffer& src, std::size_t src_begin, std::size_t count) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    i = copy_over_sse2(dst, dst_begin, src, src_begin, count);
+#endif
+    for (; i < count; ++i) {
+        const std::size_t d = dst_begin + i;
+        const std::size_t s = src_begin + i;
+        if (src.alpha[s] != 0) {
+            dst.glyphs[d] = src.glyphs[s];
+            dst.r[d] = src.r[s];
+            dst.g[d] = src.g[s];
+            dst.b[d] = src.b[s];
+            dst.styles[d] = src.styles[s];
+            dst.alpha[d] = src.alpha[s];
+        }
+    }
+}
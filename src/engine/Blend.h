@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Framebuffer.h"
+
+// Composites `src` over `dst` cell by cell (both must have the same size).
+// Colors mix by the source alpha; over an empty destination cell the source is
+// copied unchanged, so a single translucent layer keeps its configured color.
+// The glyph and style come from whichever cell dominates: the source when its
+// alpha is at least one half, otherwise the destination.
+void blend_over(Framebuffer& dst, const Framebuffer& src);
+
+// Same, limited to the cells [begin, end), so separate threads can blend
+// disjoint parts of one frame.
+void blend_over(Framebuffer& dst, const Framebuffer& src, std::size_t begin, std::size_t end);
+
+// Copies the non-empty cells among `count` cells of `src` from `src_begin`
+// over the cells of `dst` from `dst_begin`, replacing whatever was there.
+void copy_over(Framebuffer& dst, std::size_t dst_begin, const Framebuffer& src, std::size_t src_begin, std::size_t count);
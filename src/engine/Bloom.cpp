@@ -0,0 +1,117 @@
+#include "Bloom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+constexpr int kMaxRadius = 4;
+
+// Rec. 709 weights in 8-bit fixed point.
+inline uint8_t luminance(uint8_t r, uint8_t g, uint8_t b) {
+    return static_cast<uint8_t>((54U * r + 183U * g + 19U * b + 128U) >> 8U);
+}
+} // namespace
+
+void Bloom::configure(const BloomConfig& config) {
+    config_ = config;
+    radius_x_ = std::clamp(config.radius, 1, kMaxRadius);
+    radius_y_ = std::max(1, (radius_x_ + 1) / 2);
+    threshold_ = static_cast<uint8_t>(std::lround(std::clamp(config.threshold, 0.0f, 1.0f) * 255.0f));
+
+    // Normalizes the box sum and applies the gain in one 0.16 multiply.
+    const int taps = (2 * radius_x_ + 1) * (2 * radius_y_ + 1);
+    const float gain = std::max(0.0f, config.intensity) * 65536.0f / static_cast<float>(taps);
+    gain_ = static_cast<uint16_t>(std::min(65535.0f, gain));
+    rows_ = 0;
+    cols_ = 0;
+}
+
+void Bloom::resize(unsigned int rows, unsigned int cols) {
+    rows_ = rows;
+    cols_ = cols;
+    padded_row_.assign(static_cast<std::size_t>(cols) + 2U * static_cast<std::size_t>(radius_x_), 0);
+    row_sums_.assign((static_cast<std::size_t>(rows) + 2U * static_cast<std::size_t>(radius_y_)) * cols, 0);
+}
+
+void Bloom::apply(Framebuffer& frame) {
+    if (frame.rows != rows_ || frame.cols != cols_) {
+        resize(frame.rows, frame.cols);
+    }
+    if (frame.size() == 0) {
+        return;
+    }
+    blur_rows(frame);
+    blur_columns(frame);
+}
+
+void Bloom::blur_rows(const Framebuffer& frame) {
+    const std::size_t cols = cols_;
+    const int taps = 2 * radius_x_ + 1;
+    uint8_t* bright = padded_row_.data() + radius_x_;
+
+    for (unsigned int y = 0; y < rows_; ++y) {
+        // Bright pass: only lit cells at or above the threshold contribute.
+        const std::size_t row = static_cast<std::size_t>(y) * cols;
+        for (std::size_t x = 0; x < cols; ++x) {
+            const std::size_t cell = row + x;
+            const uint8_t lum = luminance(frame.r[cell], frame.g[cell], frame.b[cell]);
+            bright[x] = (frame.alpha[cell] != 0 && lum >= threshold_) ? lum : uint8_t{0};
+        }
+
+        uint16_t* sums = row_sums_.data() + (static_cast<std::size_t>(y) + static_cast<std::size_t>(radius_y_)) * cols;
+        std::size_t x = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 8 <= cols; x += 8) {
+            __m128i acc = zero;
+            for (int k = 0; k < taps; ++k) {
+                const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(padded_row_.data() + x + k));
+                acc = _mm_add_epi16(acc, _mm_unpacklo_epi8(bytes, zero));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + x), acc);
+        }
+#endif
+        for (; x < cols; ++x) {
+            unsigned sum = 0;
+            for (int k = 0; k < taps; ++k) {
+                sum += padded_row_[x + static_cast<std::size_t>(k)];
+            }
+            sums[x] = static_cast<uint16_t>(sum);
+        }
+    }
+}
+
+void Bloom::blur_columns(Framebuffer& frame) const {
+    const std::size_t cols = cols_;
+    const int taps = 2 * radius_y_ + 1;
+
+    for (unsigned int y = 0; y < rows_; ++y) {
+        // Row y of the output sums padded rows y .. y + 2 * radius_y_.
+        const uint16_t* top = row_sums_.data() + static_cast<std::size_t>(y) * cols;
+        uint8_t* glow = frame.glow.data() + static_cast<std::size_t>(y) * cols;
+        std::size_t x = 0;
+#if defined(__SSE2__)
+        const __m128i gain = _mm_set1_epi16(static_cast<short>(gain_));
+        for (; x + 8 <= cols; x += 8) {
+            __m128i acc = _mm_setzero_si128();
+            for (int k = 0; k < taps; ++k) {
+                acc = _mm_add_epi16(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + static_cast<std::size_t>(k) * cols + x)));
+            }
+            const __m128i scaled = _mm_mulhi_epu16(acc, gain);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(glow + x), _mm_packus_epi16(scaled, scaled));
+        }
+#endif
+        for (; x < cols; ++x) {
+            unsigned sum = 0;
+            for (int k = 0; k < taps; ++k) {
+                sum += top[static_cast<std::size_t>(k) * cols + x];
+            }
+            glow[x] = static_cast<uint8_t>(std::min(255U, (sum * gain_) >> 16U));
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Framebuffer.h"
+
+struct BloomConfig {
+    bool enabled{false};
+    // Cells whose luminance is below this fraction of white do not glow.
+    float threshold{0.8f};
+    // Horizontal blur radius in cells; the vertical radius is about half of
+    // it because cells are roughly twice as tall as they are wide.
+    int radius{2};
+    // Gain on the blurred luminance before it is applied as background.
+    float intensity{4.0f};
+    // 0xRRGGBBAA; the alpha byte is ignored.
+    uint32_t color{0x00FF00FF};
+};
+
+// Post-process that spreads the luminance of bright cells into a glow plane.
+// The bright pass, a separable box blur and the gain run over flat buffers
+// (SSE2 where available); the Compositor turns the result into background
+// color around the glyphs.
+class Bloom {
+public:
+    void configure(const BloomConfig& config);
+    bool enabled() const { return config_.enabled; }
+    const BloomConfig& config() const { return config_; }
+
+    // Fills `frame.glow` from the frame's colors and alpha.
+    void apply(Framebuffer& frame);
+
+private:
+    void resize(unsigned int rows, unsigned int cols);
+    void blur_rows(const Framebuffer& frame);
+    void blur_columns(Framebuffer& frame) const;
+
+    BloomConfig config_{};
+    int radius_x_{2};
+    int radius_y_{1};
+    uint8_t threshold_{204};
+    uint16_t gain_{0};
+    unsigned int rows_{0};
+    unsigned int cols_{0};
+    // One row of bright-pass luminance with `radius_x_` zero cells each side.
+    std::vector<uint8_t> padded_row_{};
+    // Horizontal sums with `radius_y_` zero rows above and below.
+    std::vector<uint16_t> row_sums_{};
+};
@@ -0,0 +1,236 @@
+#include "BroadcastServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+constexpr int kListenBacklog = 16;
+constexpr std::size_t kViewerReadChunk = 64 * 1024;
+constexpr char kViewerEnter[] = "\x1b[?1049h\x1b[?25l\x1b[2J";
+constexpr char kViewerLeave[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+std::atomic<bool> viewer_interrupted{false};
+
+void handle_viewer_signal(int /*signal*/) {
+    viewer_interrupted = true;
+}
+
+bool fill_address(const std::string& path, sockaddr_un& address, std::string& error) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        error = "socket path '" + path + "' is empty or too long";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool write_all(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+} // namespace
+
+BroadcastServer::BroadcastServer(std::string socket_path)
+    : socket_path_(std::move(socket_path)) {}
+
+BroadcastServer::~BroadcastServer() {
+    for (const auto& viewer : viewers_) {
+        ::close(viewer.fd);
+    }
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        ::unlink(socket_path_.c_str());
+    }
+    if (capture_ != nullptr) {
+        std::fclose(capture_);
+    }
+    std::free(capture_buffer_);
+}
+
+bool BroadcastServer::start(std::string& error) {
+    sockaddr_un address{};
+    if (!fill_address(socket_path_, address, error)) {
+        return false;
+    }
+
+    // Only replace a stale socket; never clobber a regular file.
+    struct stat existing {};
+    if (::lstat(socket_path_.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        ::unlink(socket_path_.c_str());
+    }
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+    if (::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(listen_fd_, kListenBacklog) != 0) {
+        error = "cannot listen on '" + socket_path_ + "': " + std::strerror(errno);
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    capture_ = ::open_memstream(&capture_buffer_, &capture_size_);
+    if (capture_ == nullptr) {
+        error = std::string("open_memstream: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void BroadcastServer::publish(struct ncplane* pile) {
+    if (listen_fd_ < 0 || capture_ == nullptr || pile == nullptr) {
+        return;
+    }
+
+    accept_viewers();
+    if (viewers_.empty()) {
+        return;
+    }
+
+    // Encode the whole frame (not a damage diff) so that viewers which skip
+    // frames or attach late always receive a self-contained picture.
+    std::rewind(capture_);
+    if (ncpile_render_to_file(pile, capture_) != 0 || std::fflush(capture_) != 0) {
+        return;
+    }
+
+    auto frame = acquire_frame();
+    frame->bytes.assign(capture_buffer_, capture_buffer_ + capture_size_);
+    frame->sequence = ++sequence_;
+    latest_ = std::move(frame);
+
+    for (auto& viewer : viewers_) {
+        if (!viewer.frame) {
+            viewer.frame = latest_;
+            viewer.offset = 0;
+        }
+        if (!flush_viewer(viewer)) {
+            ::close(viewer.fd);
+            viewer.fd = -1;
+        }
+    }
+
+    viewers_.erase(
+        std::remove_if(viewers_.begin(), viewers_.end(), [](const Viewer& viewer) { return viewer.fd < 0; }),
+        viewers_.end());
+}
+
+void BroadcastServer::accept_viewers() {
+    while (true) {
+        const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        viewers_.push_back(Viewer{fd, nullptr, 0});
+    }
+}
+
+bool BroadcastServer::flush_viewer(Viewer& viewer) {
+    while (viewer.frame) {
+        const auto& bytes = viewer.frame->bytes;
+        const std::size_t remaining = bytes.size() - viewer.offset;
+        if (remaining > 0) {
+            const ssize_t sent = ::send(viewer.fd, bytes.data() + viewer.offset, remaining, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            viewer.offset += static_cast<std::size_t>(sent);
+            if (viewer.offset < bytes.size()) {
+                continue;
+            }
+        }
+
+        // Frame complete: skip whatever was published meanwhile and move to
+        // the newest frame, or go idle if this already was the newest.
+        if (viewer.frame != latest_) {
+            viewer.frame = latest_;
+            viewer.offset = 0;
+        } else {
+            viewer.frame.reset();
+            viewer.offset = 0;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<BroadcastServer::Frame> BroadcastServer::acquire_frame() {
+    for (const auto& frame : frame_pool_) {
+        if (frame.use_count() == 1) {
+            return frame;
+        }
+    }
+    frame_pool_.push_back(std::make_shared<Frame>());
+    return frame_pool_.back();
+}
+
+int run_broadcast_viewer(const std::string& socket_path) {
+    sockaddr_un address{};
+    std::string error;
+    if (!fill_address(socket_path, address, error)) {
+        std::cerr << "Cannot attach viewer: " << error << '\n';
+        return 1;
+    }
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Cannot attach viewer to '" << socket_path << "': " << std::strerror(errno) << '\n';
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return 1;
+    }
+
+    struct sigaction action {};
+    action.sa_handler = handle_viewer_signal;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    write_all(STDOUT_FILENO, kViewerEnter, sizeof(kViewerEnter) - 1);
+    std::vector<char> buffer(kViewerReadChunk);
+    while (!viewer_interrupted) {
+        const ssize_t received = ::read(fd, buffer.data(), buffer.size());
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0 || !write_all(STDOUT_FILENO, buffer.data(), static_cast<std::size_t>(received))) {
+            break;
+        }
+    }
+    write_all(STDOUT_FILENO, kViewerLeave, sizeof(kViewerLeave) - 1);
+
+    ::close(fd);
+    return 0;
+}
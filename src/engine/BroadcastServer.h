@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <notcurses/notcurses.h>
+
+// Serves each rendered frame, encoded once, to any number of viewers attached
+// over a Unix domain socket. Viewers that cannot keep up finish the frame they
+// are writing and then jump straight to the newest one.
+class BroadcastServer {
+public:
+    explicit BroadcastServer(std::string socket_path);
+    ~BroadcastServer();
+
+    BroadcastServer(const BroadcastServer&) = delete;
+    BroadcastServer& operator=(const BroadcastServer&) = delete;
+
+    bool start(std::string& error);
+    void publish(struct ncplane* pile);
+    std::size_t viewer_count() const { return viewers_.size(); }
+
+private:
+    struct Frame {
+        std::vector<char> bytes{};
+        std::uint64_t sequence{0};
+    };
+
+    struct Viewer {
+        int fd{-1};
+        std::shared_ptr<const Frame> frame{};
+        std::size_t offset{0};
+    };
+
+    void accept_viewers();
+    bool flush_viewer(Viewer& viewer);
+    std::shared_ptr<Frame> acquire_frame();
+
+    std::string socket_path_;
+    int listen_fd_{-1};
+    FILE* capture_{nullptr};
+    char* capture_buffer_{nullptr};
+    std::size_t capture_size_{0};
+    std::vector<Viewer> viewers_{};
+    std::vector<std::shared_ptr<Frame>> frame_pool_{};
+    std::shared_ptr<const Frame> latest_{};
+    std::uint64_t sequence_{0};
+};
+
+// Attaches to a broadcasting ncmatrix instance and copies its frames to stdout.
+int run_broadcast_viewer(const std::string& socket_path);
@@ -0,0 +1,288 @@
+#include "Compositor.h"
+
+#include <algorithm>
+
+#include "Blend.h"
+#include "utils/Utf8.h"
+
+namespace {
+constexpr uint8_t kGlowMask = 0xF0;
+// Frames smaller than this are rasterized on the calling thread; waking the
+// pool costs more than it saves.
+constexpr std::size_t kBandedMinCells = 64 * 1024;
+constexpr unsigned int kBandRows = 16;
+
+// Applies one command to `target`, clipped to the rows [top, bottom).
+void rasterize_command(const DrawCommand& command, const DrawList& list, Framebuffer& target, int top, int bottom) {
+    const auto& pool = list.glyph_pool();
+    const int cols = static_cast<int>(target.cols);
+    switch (command.op) {
+    case DrawOp::Cell:
+        if (command.y >= top && command.y < bottom && command.x >= 0 && command.x < cols) {
+            target.set(static_cast<unsigned int>(command.y), static_cast<unsigned int>(command.x),
+                       static_cast<char32_t>(command.glyph), command.fg, command.alpha, command.style);
+        }
+        break;
+    case DrawOp::Span: {
+        if (command.y < top || command.y >= bottom) {
+            break;
+        }
+        const int begin = std::max(0, command.x);
+        const int end = std::min(cols, command.x + static_cast<int>(command.count));
+        for (int x = begin; x < end; ++x) {
+            const char32_t glyph = pool[command.glyph + static_cast<uint32_t>(x - command.x)];
+            target.set(static_cast<unsigned int>(command.y), static_cast<unsigned int>(x), glyph, command.fg, command.alpha,
+                       command.style);
+        }
+        break;
+    }
+    case DrawOp::Fill: {
+        const int first_row = std::max(top, command.y);
+        const int last_row = std::min(bottom, command.y + static_cast<int>(command.height));
+        const int left = std::max(0, command.x);
+        const int right = std::min(cols, command.x + static_cast<int>(command.count));
+        for (int y = first_row; y < last_row; ++y) {
+            for (int x = left; x < right; ++x) {
+                target.set(static_cast<unsigned int>(y), static_cast<unsigned int>(x),
+                           static_cast<char32_t>(command.glyph), command.fg, command.alpha, command.style);
+            }
+        }
+        break;
+    }
+    case DrawOp::Surface: {
+        // Surfaces are laid out for their pane; one that no longer fits the
+        // frame after a resize is skipped.
+        const Framebuffer& source = list.surface_at(command.glyph);
+        const int surface_cols = static_cast<int>(source.cols);
+        if (command.x < 0 || command.x + surface_cols > cols) {
+            break;
+        }
+        const int first_row = std::max({top, command.y, 0});
+        const int last_row = std::min({bottom, command.y + static_cast<int>(source.rows), static_cast<int>(target.rows)});
+        if (first_row >= last_row) {
+            break;
+        }
+        const auto source_row = static_cast<unsigned int>(first_row - command.y);
+        if (surface_cols == cols) {
+            // Full-width surfaces are contiguous in the frame as well.
+            copy_over(target, target.index(static_cast<unsigned int>(first_row), 0), source, source.index(source_row, 0),
+                      static_cast<std::size_t>(last_row - first_row) * source.cols);
+            break;
+        }
+        for (int y = first_row; y < last_row; ++y) {
+            copy_over(target, target.index(static_cast<unsigned int>(y), static_cast<unsigned int>(command.x)), source,
+                      source.index(source_row + static_cast<unsigned int>(y - first_row), 0), source.cols);
+        }
+        break;
+    }
+    }
+}
+} // namespace
+
+void Compositor::compose(const DrawList& list, const Context& context, bool erase_plane) {
+    if (context.root_plane == nullptr) {
+        return;
+    }
+
+    rasterize_frame(list, context.rows, context.cols);
+
+    if (bloom_.enabled()) {
+        bloom_.apply(frame_);
+    }
+
+    if (erase_plane) {
+        ncplane_erase(context.root_plane);
+    }
+    emit(context.root_plane, context.output, erase_plane);
+}
+
+void Compositor::rasterize_frame(const DrawList& list, unsigned int rows, unsigned int cols) {
+    if (frame_.rows != rows || frame_.cols != cols) {
+        frame_.resize(rows, cols);
+        layer_.resize(rows, cols);
+        run_.reserve(static_cast<std::size_t>(cols) * 4U + 1U);
+        bins_.resize((rows + kBandRows - 1U) / kBandRows);
+    }
+
+    if (raster_threads_ != 1 && frame_.size() >= kBandedMinCells) {
+        rasterize_banded(list);
+        return;
+    }
+
+    frame_.clear();
+    const auto& commands = list.commands();
+    std::size_t begin = 0;
+    while (begin < commands.size()) {
+        const uint16_t layer = commands[begin].layer;
+        std::size_t end = begin + 1;
+        while (end < commands.size() && commands[end].layer == layer) {
+            ++end;
+        }
+
+        if (begin == 0) {
+            rasterize(list, begin, end, frame_);
+        } else {
+            layer_.clear();
+            rasterize(list, begin, end, layer_);
+            blend_over(frame_, layer_);
+        }
+        begin = end;
+    }
+}
+
+void Compositor::rasterize(const DrawList& list, std::size_t begin, std::size_t end, Framebuffer& target) {
+    // Within a layer commands are applied in recording order, so a later
+    // command on the same cell replaces the earlier one and only the visible
+    // glyph is emitted.
+    const auto& commands = list.commands();
+    for (std::size_t i = begin; i < end; ++i) {
+        rasterize_command(commands[i], list, target, 0, static_cast<int>(target.rows));
+    }
+}
+
+void Compositor::rasterize_banded(const DrawList& list) {
+    if (pool_.threads() == 1) {
+        pool_.resize(raster_threads_);
+    }
+
+    // Effects resolve slant and column wrap before recording, so a command
+    // only spans the rows it covers; bands are full width, so a trail that
+    // wraps around the edge stays in the bands of its rows.
+    const auto& commands = list.commands();
+    const int rows = static_cast<int>(frame_.rows);
+    for (auto& bin : bins_) {
+        bin.clear();
+    }
+    for (std::size_t i = 0; i < commands.size(); ++i) {
+        const DrawCommand& command = commands[i];
+        const int height = command.op == DrawOp::Fill || command.op == DrawOp::Surface ? static_cast<int>(command.height) : 1;
+        const int top = std::max(0, command.y);
+        const int bottom = std::min(rows, command.y + height);
+        for (int band = top / static_cast<int>(kBandRows); band * static_cast<int>(kBandRows) < bottom; ++band) {
+            bins_[static_cast<std::size_t>(band)].push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    const uint16_t base_layer = commands.empty() ? 0 : commands.front().layer;
+    auto task = [&](std::size_t band) { rasterize_band(list, band, base_layer); };
+    pool_.run(bins_.size(), task);
+}
+
+void Compositor::rasterize_band(const DrawList& list, std::size_t band, uint16_t base_layer) {
+    const auto top = static_cast<unsigned int>(band) * kBandRows;
+    const unsigned int bottom = std::min(frame_.rows, top + kBandRows);
+    const std::size_t first_cell = frame_.index(top, 0);
+    const std::size_t last_cell = frame_.index(bottom, 0);
+    const auto clear = [&](Framebuffer& target) {
+        std::fill(target.alpha.begin() + static_cast<std::ptrdiff_t>(first_cell),
+                  target.alpha.begin() + static_cast<std::ptrdiff_t>(last_cell), uint8_t{0});
+    };
+
+    // The same layer grouping as the single-threaded path, restricted to
+    // this band's rows.
+    const auto& commands = list.commands();
+    const auto& bin = bins_[band];
+    clear(frame_);
+    std::size_t begin = 0;
+    while (begin < bin.size()) {
+        const uint16_t layer = commands[bin[begin]].layer;
+        std::size_t end = begin + 1;
+        while (end < bin.size() && commands[bin[end]].layer == layer) {
+            ++end;
+        }
+
+        Framebuffer& target = layer == base_layer ? frame_ : layer_;
+        if (layer != base_layer) {
+            clear(layer_);
+        }
+        for (std::size_t i = begin; i < end; ++i) {
+            rasterize_command(commands[bin[i]], list, target, static_cast<int>(top), static_cast<int>(bottom));
+        }
+        if (layer != base_layer) {
+            blend_over(frame_, layer_, first_cell, last_cell);
+        }
+        begin = end;
+    }
+}
+
+void Compositor::emit(struct ncplane* plane, const OutputSettings& output, bool fill_glow) {
+    color::Pen pen(plane, output.palette256);
+    char encoded[4];
+    const bool bloom = bloom_.enabled();
+    const color::Rgb glow_color = color::decode_rgba(bloom_.config().color);
+
+    // Glow is snapped to 16 levels so neighbouring cells share a background
+    // and runs stay long.
+    const auto glow_level = [&](std::size_t cell) -> uint8_t {
+        return bloom ? static_cast<uint8_t>(frame_.glow[cell] & kGlowMask) : uint8_t{0};
+    };
+    // Empty cells are only written for their glow when nothing else draws on
+    // the plane this frame.
+    const auto visible = [&](std::size_t cell) {
+        return frame_.alpha[cell] != 0 || (fill_glow && glow_level(cell) != 0);
+    };
+
+    for (unsigned int y = 0; y < frame_.rows; ++y) {
+        unsigned int x = 0;
+        while (x < frame_.cols) {
+            std::size_t cell = frame_.index(y, x);
+            if (!visible(cell)) {
+                ++x;
+                continue;
+            }
+
+            // Merge the longest run of adjacent cells sharing color, style and
+            // glow into a single string write. Glow-only cells are blanks and
+            // join any run with the same glow. A glyph that is not one column
+            // wide would shift the rest of the run, so it is written alone.
+            const unsigned int run_x = x;
+            const uint8_t run_glow = glow_level(cell);
+            bool has_fg = false;
+            color::Rgb run_fg{};
+            uint8_t run_style = 0;
+            run_.clear();
+            while (x < frame_.cols) {
+                cell = frame_.index(y, x);
+                if (!visible(cell) || glow_level(cell) != run_glow) {
+                    break;
+                }
+                bool alone = false;
+                if (frame_.alpha[cell] == 0) {
+                    run_.push_back(' ');
+                } else {
+                    alone = !utf8::single_column(frame_.glyphs[cell]);
+                    if (alone && x != run_x) {
+                        break;
+                    }
+                    if (!has_fg) {
+                        run_fg = frame_.fg(cell);
+                        run_style = frame_.styles[cell];
+                        has_fg = true;
+                    } else if (frame_.fg(cell) != run_fg || frame_.styles[cell] != run_style) {
+                        break;
+                    }
+                    run_.append(encoded, utf8::encode(frame_.glyphs[cell], encoded));
+                }
+                ++x;
+                if (alone) {
+                    break;
+                }
+            }
+
+            if (has_fg) {
+                pen.set(run_fg, (run_style & NCSTYLE_BOLD) != 0U);
+            }
+            if (run_glow != 0) {
+                pen.set_background(color::scale(glow_color, static_cast<float>(run_glow) / 255.0f));
+            } else if (bloom) {
+                pen.reset_background();
+            }
+            ncplane_putstr_yx(plane, static_cast<int>(y), static_cast<int>(run_x), run_.c_str());
+        }
+    }
+
+    ncplane_off_styles(plane, NCSTYLE_BOLD);
+    if (bloom) {
+        ncplane_set_bg_default(plane);
+    }
+}
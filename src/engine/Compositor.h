@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <notcurses/notcurses.h>
+
+#include "Bloom.h"
+#include "Context.h"
+#include "DrawList.h"
+#include "Framebuffer.h"
+#include "WorkerPool.h"
+
+// Resolves a frame's draw commands into a Framebuffer, culling overdrawn
+// cells, then writes the result to the plane in row-major runs that share
+// color and style. Each layer after the first is rasterized on its own and
+// alpha-blended over the layers below it. An optional Bloom pass adds a glow
+// around bright cells as background color.
+//
+// Large frames are rasterized in bands of rows on a worker pool: commands are
+// binned by the bands they touch, and each band is cleared, rasterized and
+// blended by one thread, so threads never write the same cell.
+class Compositor {
+public:
+    void compose(const DrawList& list, const Context& context, bool erase_plane);
+    void set_bloom(const BloomConfig& config) { bloom_.configure(config); }
+    // Threads for the banded path; 0 uses every hardware thread and 1 keeps
+    // rasterization on the calling thread.
+    void set_raster_threads(unsigned int threads) { raster_threads_ = threads; }
+    // Rasterizes and blends `list` into frame() without touching a plane.
+    void rasterize_frame(const DrawList& list, unsigned int rows, unsigned int cols);
+    const Framebuffer& frame() const { return frame_; }
+
+private:
+    void rasterize(const DrawList& list, std::size_t begin, std::size_t end, Framebuffer& target);
+    void rasterize_banded(const DrawList& list);
+    void rasterize_band(const DrawList& list, std::size_t band, uint16_t base_layer);
+    void emit(struct ncplane* plane, const OutputSettings& output, bool fill_glow);
+
+    Framebuffer frame_{};
+    Framebuffer layer_{};
+    Bloom bloom_{};
+    std::string run_{};
+    unsigned int raster_threads_{0};
+    WorkerPool pool_{};
+    // Command indices per band of rows, in recording order.
+    std::vector<std::vector<uint32_t>> bins_{};
+};
@@ -1,9 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <random>
 
 #include <notcurses/notcurses.h>
 
+// Output-side fidelity knobs shared by all effects.
+struct OutputSettings {
+    // Number of discrete tail brightness levels; 0 keeps the continuous fade.
+    int fadeLevels{0};
+    // Emit colors as xterm 256-color palette indices instead of 24-bit RGB.
+    bool palette256{false};
+};
+
+// Scale factors the engine may lower under load. Effects apply them on top of
+// their configuration without reinitializing their streams.
+struct QualitySettings {
+    // Fraction of the configured streams that keep respawning.
+    float density{1.0f};
+    // Fraction of each trail that is drawn.
+    float trailLength{1.0f};
+    // Multiplier on the per-frame shimmer probability.
+    float shimmer{1.0f};
+};
+
+// Soundtrack energies from the audio analyzer, each 0..1 after automatic
+// gain. `active` is false when no audio source is playing.
+struct AudioLevels {
+    static constexpr int kBands = 8;
+
+    bool active{false};
+    float level{0.0f};
+    // Averages of the low, middle and high bands.
+    float bass{0.0f};
+    float mid{0.0f};
+    float treble{0.0f};
+    // Log-spaced from about 40 Hz to 16 kHz.
+    float bands[kBands]{};
+};
+
 struct Context {
     unsigned int rows{0};
     unsigned int cols{0};
@@ -11,6 +46,16 @@ struct Context {
     struct ncplane* root_plane{nullptr};
     std::mt19937* rng{nullptr};
     float deltaTime{0.0f};
+    // Scene time in seconds: the sum of all deltaTime steps so far, or the
+    // target of a seek.
+    float time{0.0f};
+    // Seekable mode runs on a fixed timestep and effects that support it
+    // derive their state from `time` and `seed` instead of accumulating it.
+    bool seekable{false};
+    std::uint32_t seed{0};
+    OutputSettings output{};
+    QualitySettings quality{};
+    AudioLevels audio{};
 
     void attach(struct notcurses* nc_instance, struct ncplane* plane, std::mt19937* rng_engine) {
         nc = nc_instance;
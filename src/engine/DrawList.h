@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Framebuffer.h"
+#include "utils/Color.h"
+
+enum class DrawOp : uint8_t {
+    Cell, // one glyph at (y, x)
+    Span, // `count` glyphs from the glyph pool, left to right from (y, x)
+    Fill, // a `height` x `count` rectangle of one glyph
+    Surface, // the non-empty cells of an effect-owned Framebuffer, from (0, 0)
+};
+
+struct DrawCommand {
+    DrawOp op{DrawOp::Cell};
+    uint8_t style{0};
+    uint16_t height{1};
+    uint32_t count{1};
+    int y{0};
+    int x{0};
+    // Glyph for Cell/Fill, offset into the glyph pool for Span, index into
+    // the surfaces for Surface.
+    uint32_t glyph{0};
+    color::Rgb fg{};
+    uint8_t alpha{255};
+    uint16_t layer{0};
+};
+
+// Per-frame buffer of draw commands owned by the Engine. Effects append to it
+// instead of touching the plane; the Compositor resolves it into the frame.
+// Commands are grouped into layers that are alpha-blended bottom to top.
+class DrawList {
+public:
+    void clear() {
+        commands_.clear();
+        glyph_pool_.clear();
+        surfaces_.clear();
+        layer_ = 0;
+        layer_used_ = false;
+        reset_viewport();
+    }
+
+    // Starts a new layer above everything recorded so far. The Engine opens
+    // one per effect; effects may open more for their own stacking.
+    void begin_layer() {
+        if (layer_used_) {
+            layer_++;
+            layer_used_ = false;
+        }
+    }
+
+    // Until the next call, coordinates are relative to the `rows` x `cols`
+    // rectangle at (top, left) and commands are clipped to it, so an effect
+    // can draw into a pane as if it were the whole screen.
+    void set_viewport(int top, int left, unsigned rows, unsigned cols) {
+        top_ = top;
+        left_ = left;
+        rows_ = static_cast<int>(std::min<unsigned>(rows, kUnbounded));
+        cols_ = static_cast<int>(std::min<unsigned>(cols, kUnbounded));
+    }
+    void reset_viewport() { set_viewport(0, 0, kUnbounded, kUnbounded); }
+
+    void reserve(std::size_t commands, std::size_t pooled_glyphs) {
+        commands_.reserve(commands);
+        glyph_pool_.reserve(pooled_glyphs);
+    }
+
+    void cell(int y, int x, char32_t glyph, color::Rgb fg, unsigned style = 0, uint8_t alpha = 255) {
+        if (y < 0 || y >= rows_ || x < 0 || x >= cols_) {
+            return;
+        }
+        push(DrawCommand{DrawOp::Cell, static_cast<uint8_t>(style), 1, 1, y + top_, x + left_, static_cast<uint32_t>(glyph), fg, alpha, layer_});
+    }
+
+    void span(int y, int x, const char32_t* glyphs, std::size_t count, color::Rgb fg, unsigned style = 0, uint8_t alpha = 255) {
+        if (y < 0 || y >= rows_) {
+            return;
+        }
+        const int begin = std::max(0, x);
+        const int end = static_cast<int>(std::min<long long>(cols_, static_cast<long long>(x) + static_cast<long long>(count)));
+        if (begin >= end) {
+            return;
+        }
+        const auto offset = static_cast<uint32_t>(glyph_pool_.size());
+        glyph_pool_.insert(glyph_pool_.end(), glyphs + (begin - x), glyphs + (end - x));
+        push(DrawCommand{DrawOp::Span, static_cast<uint8_t>(style), 1, static_cast<uint32_t>(end - begin), y + top_, begin + left_, offset, fg, alpha, layer_});
+    }
+
+    void fill(int y, int x, unsigned height, unsigned width, char32_t glyph, color::Rgb fg, unsigned style = 0, uint8_t alpha = 255) {
+        const int top = std::max(0, y);
+        const int bottom = static_cast<int>(std::min<long long>(rows_, static_cast<long long>(y) + height));
+        const int left = std::max(0, x);
+        const int right = static_cast<int>(std::min<long long>(cols_, static_cast<long long>(x) + width));
+        if (top >= bottom || left >= right) {
+            return;
+        }
+        push(DrawCommand{DrawOp::Fill, static_cast<uint8_t>(style), static_cast<uint16_t>(bottom - top), static_cast<uint32_t>(right - left),
+                         top + top_, left + left_, static_cast<uint32_t>(glyph), fg, alpha, layer_});
+    }
+
+    // Draws every cell of `source` that has a nonzero alpha. The effect keeps
+    // `source` alive and unchanged until the frame has been composed; this
+    // suits state that persists between frames, which would otherwise be
+    // re-recorded cell by cell.
+    void surface(const Framebuffer& source) {
+        if (source.size() == 0) {
+            return;
+        }
+        const auto index = static_cast<uint32_t>(surfaces_.size());
+        surfaces_.push_back(&source);
+        push(DrawCommand{DrawOp::Surface, 0, static_cast<uint16_t>(source.rows), source.cols, top_, left_, index, {}, 255, layer_});
+    }
+
+    bool empty() const { return commands_.empty(); }
+    const std::vector<DrawCommand>& commands() const { return commands_; }
+    const std::vector<char32_t>& glyph_pool() const { return glyph_pool_; }
+    const Framebuffer& surface_at(uint32_t index) const { return *surfaces_[index]; }
+
+private:
+    void push(const DrawCommand& command) {
+        commands_.push_back(command);
+        layer_used_ = true;
+    }
+
+    // Leaves headroom so that adding the origin cannot overflow.
+    static constexpr unsigned kUnbounded = std::numeric_limits<int>::max() / 2;
+
+    std::vector<DrawCommand> commands_{};
+    std::vector<char32_t> glyph_pool_{};
+    std::vector<const Framebuffer*> surfaces_{};
+    uint16_t layer_{0};
+    bool layer_used_{false};
+    int top_{0};
+    int left_{0};
+    int rows_{static_cast<int>(kUnbounded)};
+    int cols_{static_cast<int>(kUnbounded)};
+};
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+
 #include "Context.h"
+#include "DrawList.h"
+
+class SnapshotReader;
+class SnapshotWriter;
 
 class Effect {
 public:
@@ -9,4 +16,43 @@ public:
     virtual void update(const Context& context) = 0;
     virtual void render(const Context& context) = 0;
     virtual bool isFinished() const = 0;
+
+    // Command-buffer render path. Effects that append their frame to `list`
+    // and return true are composited by the Engine; the default keeps the
+    // direct render() path.
+    virtual bool record(const Context& /*context*/, DrawList& /*list*/) { return false; }
+
+    // True once the effect's output will not change again until input or a
+    // resize. When every effect is static the Engine stops drawing frames and
+    // waits for an event instead.
+    virtual bool isStatic() const { return false; }
+
+    // Memory held for per-stream state, reported after fixed-frame runs.
+    struct Footprint {
+        std::size_t streams{0};
+        std::size_t bytes{0};
+    };
+    virtual Footprint footprint() const { return {}; }
+
+    // Seekable mode. The Engine keeps periodic snapshots made with clone();
+    // effects that return nullptr cannot be seeked. Effects reporting
+    // seekable() rebuild their state for context.time directly in seek(),
+    // the others are replayed with update() from the nearest snapshot.
+    virtual std::unique_ptr<Effect> clone() const { return nullptr; }
+    // Whether clone() returns a copy, answered without making one.
+    virtual bool clonable() const { return false; }
+    // Copies this effect's state into `target`, an earlier clone, reusing its
+    // storage so that keyframes taken during playback do not allocate.
+    // Returns false if `target` is not the same kind of effect.
+    virtual bool copy_to(Effect& /*target*/) const { return false; }
+    virtual bool seekable() const { return false; }
+    virtual void seek(const Context& /*context*/) {}
+
+    // Warm start. save() writes the state a clone would copy, apart from what
+    // the config determines; load() reads it into an effect made from the
+    // same config, on a screen of the same size, and returns false if the
+    // data does not fit. Effects whose save() returns false always start
+    // fresh, and so does every scene that contains one.
+    virtual bool save(SnapshotWriter& /*out*/) const { return false; }
+    virtual bool load(SnapshotReader& /*in*/) { return false; }
 };
@@ -0,0 +1,438 @@
+#include "EffectManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+// Budget smoothing and hysteresis, as for the frame-time governor.
+constexpr float kCostSmoothing = 0.1f;
+constexpr int kThrottleFrames = 30;
+constexpr int kRecoverFrames = 120;
+constexpr float kRecoverRatio = 0.5f;
+// At most one update in 16 due frames.
+constexpr uint8_t kMaxThrottle = 4;
+// Rate-limited panes start at spread-out phases so that a grid of panes with
+// one rate does not update all at once.
+constexpr float kPhaseStep = 0.618034f;
+
+using Clock = std::chrono::steady_clock;
+
+float elapsed_ms(Clock::time_point since) {
+    return std::chrono::duration<float, std::milli>(Clock::now() - since).count();
+}
+
+int scale_edge(float fraction, unsigned int size) {
+    return std::clamp(static_cast<int>(std::lround(fraction * static_cast<float>(size))), 0, static_cast<int>(size));
+}
+} // namespace
+
+EffectManager::~EffectManager() {
+    clear();
+}
+
+void EffectManager::add(std::unique_ptr<Effect> effect, const PaneConfig& config) {
+    if (!effect) {
+        return;
+    }
+    Pane pane;
+    pane.id = next_id_++;
+    pane.config = config;
+    pane.effect = std::move(effect);
+    if (config.updateRate > 0.0f) {
+        const float phase = std::fmod(static_cast<float>(pane.id) * kPhaseStep, 1.0f);
+        pane.pending = phase / config.updateRate;
+    }
+    insert(std::move(pane));
+}
+
+void EffectManager::insert(Pane pane) {
+    const auto position = std::upper_bound(panes_.begin(), panes_.end(), pane.config.z,
+                                           [](int z, const Pane& other) { return z < other.config.z; });
+    panes_.insert(position, std::move(pane));
+    layout_dirty_ = true;
+}
+
+void EffectManager::clear() {
+    // Effects may own planes below their pane's plane.
+    std::vector<struct ncplane*> planes;
+    for (Pane& pane : panes_) {
+        pane.effect.reset();
+        if (pane.plane != nullptr) {
+            planes.push_back(pane.plane);
+        }
+    }
+    panes_.clear();
+    for (struct ncplane* plane : planes) {
+        ncplane_destroy(plane);
+    }
+}
+
+void EffectManager::layout(struct ncplane* root_plane, unsigned int rows, unsigned int cols) {
+    if (!layout_dirty_ && root_plane == root_plane_ && rows == rows_ && cols == cols_) {
+        return;
+    }
+    root_plane_ = root_plane;
+    rows_ = rows;
+    cols_ = cols;
+    layout_dirty_ = false;
+
+    for (Pane& pane : panes_) {
+        const PaneConfig& config = pane.config;
+        const int left = scale_edge(config.x, cols);
+        const int top = scale_edge(config.y, rows);
+        const int right = std::max(left, scale_edge(config.x + config.width, cols));
+        const int bottom = std::max(top, scale_edge(config.y + config.height, rows));
+        pane.region = Region{top, left, static_cast<unsigned int>(bottom - top), static_cast<unsigned int>(right - left)};
+        pane.fullScreen = top == 0 && left == 0 && pane.region.rows == rows && pane.region.cols == cols;
+        if (pane.plane != nullptr && pane.region.rows > 0 && pane.region.cols > 0) {
+            ncplane_move_yx(pane.plane, top, left);
+            ncplane_resize_simple(pane.plane, pane.region.rows, pane.region.cols);
+        }
+    }
+    assign_layers();
+}
+
+void EffectManager::assign_layers() {
+    // Walking up in z order, a pane joins the current layer unless it
+    // overlaps a pane already in it. Within a layer later commands replace
+    // earlier ones, which is only the same as blending when nothing overlaps.
+    layer_regions_.clear();
+    const auto overlaps = [](const Region& a, const Region& b) {
+        return a.left < b.left + static_cast<int>(b.cols) && b.left < a.left + static_cast<int>(a.cols) &&
+               a.top < b.top + static_cast<int>(b.rows) && b.top < a.top + static_cast<int>(a.rows);
+    };
+    for (Pane& pane : panes_) {
+        pane.newLayer = layer_regions_.empty() ||
+                        std::any_of(layer_regions_.begin(), layer_regions_.end(),
+                                    [&](const Region& region) { return overlaps(region, pane.region); });
+        if (pane.newLayer) {
+            layer_regions_.clear();
+        }
+        layer_regions_.push_back(pane.region);
+    }
+}
+
+Context EffectManager::pane_context(const Context& context, const Pane& pane) const {
+    Context local = context;
+    local.rows = pane.region.rows;
+    local.cols = pane.region.cols;
+    local.root_plane = pane.fullScreen ? context.root_plane : pane.plane;
+    return local;
+}
+
+struct ncplane* EffectManager::ensure_plane(Pane& pane) {
+    if (pane.fullScreen) {
+        return root_plane_;
+    }
+    if (pane.plane == nullptr && root_plane_ != nullptr) {
+        ncplane_options options{};
+        options.y = pane.region.top;
+        options.x = pane.region.left;
+        options.rows = pane.region.rows;
+        options.cols = pane.region.cols;
+        options.name = "pane";
+        pane.plane = ncplane_create(root_plane_, &options);
+        stack_planes();
+    }
+    return pane.plane;
+}
+
+void EffectManager::stack_planes() {
+    // Moving each plane to the top in z order leaves the highest pane on top;
+    // planes an effect made below its pane's plane move along with it.
+    for (const Pane& pane : panes_) {
+        if (pane.plane != nullptr) {
+            ncplane_move_family_top(pane.plane);
+        }
+    }
+}
+
+void EffectManager::update(const Context& context, bool replay) {
+    const bool budgets = !context.seekable;
+    for (Pane& pane : panes_) {
+        pane.frameCost = 0.0f;
+        if (pane.finished) {
+            continue;
+        }
+        Effect& effect = *pane.effect;
+        const bool seeks = context.seekable && effect.seekable();
+        if (replay && effect.seekable()) {
+            continue;
+        }
+        // A paused or held seekable scene must not advance effects that
+        // accumulate their state; effects that seek themselves only
+        // evaluate the scene time, so they are not rate limited.
+        if (context.seekable && !seeks && context.deltaTime <= 0.0f) {
+            continue;
+        }
+        if (!seeks) {
+            pane.pending += context.deltaTime;
+            if (pane.config.updateRate > 0.0f && pane.pending * pane.config.updateRate < 1.0f) {
+                continue;
+            }
+            const uint32_t tick = pane.tick++;
+            if ((tick & ((1U << pane.throttle) - 1U)) != 0U) {
+                continue;
+            }
+        }
+        if (pane.region.rows == 0 || pane.region.cols == 0) {
+            pane.pending = 0.0f;
+            continue;
+        }
+
+        Context local = pane_context(context, pane);
+        if (!seeks) {
+            local.deltaTime = pane.pending;
+            pane.pending = 0.0f;
+        }
+        const bool timed = budgets && pane.config.budgetMs > 0.0f;
+        const Clock::time_point start = timed ? Clock::now() : Clock::time_point{};
+        effect.update(local);
+        if (timed) {
+            pane.frameCost = elapsed_ms(start);
+        }
+        pane.finished = effect.isFinished();
+    }
+}
+
+void EffectManager::draw(const Context& context, DrawList& list, bool& recorded, bool& drew_on_root) {
+    recorded = false;
+    drew_on_root = false;
+    const bool budgets = !context.seekable;
+    for (Pane& pane : panes_) {
+        if (pane.finished || pane.region.rows == 0 || pane.region.cols == 0) {
+            continue;
+        }
+        const bool timed = budgets && pane.config.budgetMs > 0.0f;
+        const Clock::time_point start = timed ? Clock::now() : Clock::time_point{};
+
+        if (pane.newLayer) {
+            list.begin_layer();
+        }
+        list.set_viewport(pane.region.top, pane.region.left, pane.region.rows, pane.region.cols);
+        Context local = pane_context(context, pane);
+        if (pane.effect->record(local, list)) {
+            recorded = true;
+        } else {
+            local.root_plane = ensure_plane(pane);
+            pane.effect->render(local);
+            drew_on_root = drew_on_root || pane.fullScreen;
+        }
+        pane.finished = pane.effect->isFinished();
+
+        if (timed) {
+            pane.frameCost += elapsed_ms(start);
+            observe_cost(pane);
+        }
+    }
+    list.reset_viewport();
+}
+
+void EffectManager::observe_cost(Pane& pane) {
+    const float budget = pane.config.budgetMs;
+    pane.smoothedCost = pane.smoothedCost == 0.0f ? pane.frameCost : pane.smoothedCost + kCostSmoothing * (pane.frameCost - pane.smoothedCost);
+    if (pane.smoothedCost > budget) {
+        pane.overBudgetFrames++;
+        pane.underBudgetFrames = 0;
+    } else if (pane.smoothedCost < budget * kRecoverRatio) {
+        pane.underBudgetFrames++;
+        pane.overBudgetFrames = 0;
+    } else {
+        pane.overBudgetFrames = 0;
+        pane.underBudgetFrames = 0;
+    }
+
+    if (pane.overBudgetFrames >= kThrottleFrames && pane.throttle < kMaxThrottle) {
+        pane.throttle++;
+        pane.overBudgetFrames = 0;
+    } else if (pane.underBudgetFrames >= kRecoverFrames && pane.throttle > 0) {
+        pane.throttle--;
+        pane.underBudgetFrames = 0;
+    }
+}
+
+void EffectManager::seek(const Context& context) {
+    for (Pane& pane : panes_) {
+        if (!pane.finished && pane.effect->seekable()) {
+            pane.effect->seek(pane_context(context, pane));
+        }
+    }
+}
+
+void EffectManager::collect() {
+    const auto first_finished = std::find_if(panes_.begin(), panes_.end(), [](const Pane& pane) { return pane.finished; });
+    if (first_finished == panes_.end()) {
+        return;
+    }
+    // One compaction pass; planes go after their effects, which may have
+    // created planes of their own below them.
+    auto kept = first_finished;
+    for (auto pane = first_finished; pane != panes_.end(); ++pane) {
+        if (!pane->finished) {
+            *kept++ = std::move(*pane);
+            continue;
+        }
+        pane->effect.reset();
+        if (pane->plane != nullptr) {
+            ncplane_destroy(pane->plane);
+            pane->plane = nullptr;
+        }
+    }
+    panes_.erase(kept, panes_.end());
+    layout_dirty_ = true;
+}
+
+bool EffectManager::all_static() const {
+    return std::all_of(panes_.begin(), panes_.end(), [](const Pane& pane) { return pane.finished || pane.effect->isStatic(); });
+}
+
+bool EffectManager::all_clonable() const {
+    return std::all_of(panes_.begin(), panes_.end(), [](const Pane& pane) { return pane.effect->clonable(); });
+}
+
+Effect::Footprint EffectManager::footprint() const {
+    Effect::Footprint total;
+    for (const Pane& pane : panes_) {
+        const Effect::Footprint footprint = pane.effect->footprint();
+        total.streams += footprint.streams;
+        total.bytes += footprint.bytes;
+    }
+    return total;
+}
+
+bool EffectManager::save(SnapshotWriter& out) const {
+    const auto live = std::count_if(panes_.begin(), panes_.end(), [](const Pane& pane) { return !pane.finished; });
+    out.put(static_cast<uint32_t>(live));
+    for (const Pane& pane : panes_) {
+        if (pane.finished) {
+            continue;
+        }
+        out.put(pane.id);
+        out.put(pane.pending);
+        out.put(pane.tick);
+        out.put(pane.throttle);
+        if (!pane.effect->save(out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EffectManager::load(SnapshotReader& in) {
+    // Effects load into clones first, so a snapshot that does not fit
+    // leaves the scene as it was.
+    struct Loaded {
+        Pane* pane{nullptr};
+        std::unique_ptr<Effect> effect{};
+        float pending{0.0f};
+        uint32_t tick{0};
+        uint8_t throttle{0};
+    };
+    uint32_t count = 0;
+    if (!in.get(count) || count > panes_.size()) {
+        return false;
+    }
+    std::vector<Loaded> loaded(count);
+    for (Loaded& entry : loaded) {
+        uint32_t id = 0;
+        if (!in.get(id) || !in.get(entry.pending) || !in.get(entry.tick) || !in.get(entry.throttle)) {
+            return false;
+        }
+        const auto pane = std::find_if(panes_.begin(), panes_.end(), [id](const Pane& candidate) { return candidate.id == id; });
+        if (pane == panes_.end()) {
+            return false;
+        }
+        const bool repeated = std::any_of(loaded.begin(), loaded.end(), [&](const Loaded& other) { return other.pane == &*pane; });
+        if (repeated || entry.throttle > kMaxThrottle) {
+            return false;
+        }
+        entry.pane = &*pane;
+        entry.effect = pane->effect->clone();
+        if (!entry.effect || !entry.effect->load(in)) {
+            return false;
+        }
+    }
+
+    for (Pane& pane : panes_) {
+        pane.finished = true;
+    }
+    for (Loaded& entry : loaded) {
+        Pane& pane = *entry.pane;
+        pane.effect = std::move(entry.effect);
+        pane.pending = entry.pending;
+        pane.tick = entry.tick;
+        pane.throttle = entry.throttle;
+        pane.finished = false;
+    }
+    collect();
+    return true;
+}
+
+void EffectManager::capture(Snapshot& into) const {
+    // Panes are only ever removed, so an earlier capture lists the live
+    // panes in the same order. Entries of finished panes keep their effect
+    // and are skipped.
+    if (into.entries_.empty()) {
+        into.entries_.reserve(panes_.size());
+    }
+    auto entry = into.entries_.begin();
+    for (const Pane& pane : panes_) {
+        if (pane.finished) {
+            continue;
+        }
+        const auto match = std::find_if(entry, into.entries_.end(), [&](const Snapshot::Entry& candidate) { return candidate.id == pane.id; });
+        for (; entry != match; ++entry) {
+            entry->live = false;
+        }
+        if (entry == into.entries_.end()) {
+            entry = into.entries_.insert(entry, Snapshot::Entry{pane.id, pane.config, pane.effect->clone()});
+        }
+        // Copying into a fresh clone as well gives it the spare capacity of
+        // the live effect, which a clone does not have.
+        if (!pane.effect->seekable() && !pane.effect->copy_to(*entry->effect)) {
+            entry->effect = pane.effect->clone();
+        }
+        entry->pending = pane.pending;
+        entry->tick = pane.tick;
+        entry->throttle = pane.throttle;
+        entry->live = true;
+        ++entry;
+    }
+    for (; entry != into.entries_.end(); ++entry) {
+        entry->live = false;
+    }
+}
+
+void EffectManager::restore(const Snapshot& snapshot) {
+    std::vector<Pane> restored;
+    restored.reserve(snapshot.entries_.size());
+    for (const Snapshot::Entry& entry : snapshot.entries_) {
+        if (!entry.live) {
+            continue;
+        }
+        Pane pane;
+        pane.id = entry.id;
+        pane.config = entry.config;
+        pane.pending = entry.pending;
+        pane.tick = entry.tick;
+        pane.throttle = entry.throttle;
+        // Entries are in z order already. An effect that seeks itself is
+        // rebuilt by seek(), so a pane that still exists keeps it.
+        const auto current = std::find_if(panes_.begin(), panes_.end(), [&](const Pane& other) { return other.id == entry.id; });
+        if (current != panes_.end()) {
+            pane.plane = current->plane;
+            current->plane = nullptr;
+            if (entry.effect->seekable() || entry.effect->copy_to(*current->effect)) {
+                pane.effect = std::move(current->effect);
+            }
+        }
+        if (!pane.effect) {
+            pane.effect = entry.effect->clone();
+        }
+        restored.push_back(std::move(pane));
+    }
+    clear();
+    panes_ = std::move(restored);
+    layout_dirty_ = true;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <notcurses/notcurses.h>
+
+#include "Context.h"
+#include "DrawList.h"
+#include "Effect.h"
+#include "utils/SnapshotIo.h"
+
+// Where an effect draws and how often it runs.
+struct PaneConfig {
+    // Left edge, top edge, width and height as fractions of the screen, so a
+    // layout follows terminal resizes. The default covers the whole screen.
+    float x{0.0f};
+    float y{0.0f};
+    float width{1.0f};
+    float height{1.0f};
+    // Panes with a higher z are drawn above lower ones; equal z keeps the
+    // order the panes were added in.
+    int z{0};
+    // Updates per second; 0 updates every frame. Skipped frames are folded
+    // into the next update's deltaTime.
+    float updateRate{0.0f};
+    // Target for the pane's update + draw time in milliseconds. While its
+    // smoothed cost stays above the target the pane updates at half its rate,
+    // then a quarter, and so on; 0 disables.
+    float budgetMs{0.0f};
+};
+
+// Runs the effects of a scene as panes: screen regions with their own update
+// rate, budget and stacking order. Each pane sees a Context sized to its
+// region. Recording panes draw into the shared DrawList through a viewport,
+// and panes that render directly get a notcurses plane covering their region
+// (stacked above the composited frame) unless they cover the whole screen.
+//
+// Panes are kept sorted by z, so a frame is one pass over a flat array.
+// Panes that do not overlap share a compositor layer, so a grid of small
+// panes composites like one full-screen effect. Finished panes are removed
+// in one sweep per frame.
+class EffectManager {
+public:
+    EffectManager() = default;
+    EffectManager(const EffectManager&) = delete;
+    EffectManager& operator=(const EffectManager&) = delete;
+    ~EffectManager();
+
+    void add(std::unique_ptr<Effect> effect, const PaneConfig& config = {});
+    // Destroys every effect, then the pane planes.
+    void clear();
+
+    bool empty() const { return panes_.empty(); }
+    std::size_t size() const { return panes_.size(); }
+
+    // Recomputes pane regions and layers when the screen size changed.
+    void layout(struct ncplane* root_plane, unsigned int rows, unsigned int cols);
+
+    // Advances the panes that are due. With `replay` (a seek catching up),
+    // effects that seek themselves are skipped; budgets are not enforced in
+    // seekable runs, whose output must not depend on the machine.
+    void update(const Context& context, bool replay = false);
+    // Records every pane into `list`, or renders it on its plane. Reports
+    // whether anything was recorded and whether a full-screen pane drew on
+    // the root plane directly.
+    void draw(const Context& context, DrawList& list, bool& recorded, bool& drew_on_root);
+    // Lets effects that seek themselves rebuild their state for context.time.
+    void seek(const Context& context);
+    // Removes the panes whose effect finished.
+    void collect();
+
+    bool all_static() const;
+    bool all_clonable() const;
+    Effect::Footprint footprint() const;
+
+    // Seekable mode: the effects and their schedules at one point in time.
+    // Restoring keeps the planes of panes that still exist.
+    class Snapshot {
+    private:
+        friend class EffectManager;
+        struct Entry {
+            uint32_t id{0};
+            PaneConfig config{};
+            std::unique_ptr<Effect> effect{};
+            float pending{0.0f};
+            uint32_t tick{0};
+            uint8_t throttle{0};
+            // Cleared for a pane that had finished by the time of the capture.
+            bool live{true};
+        };
+        std::vector<Entry> entries_{};
+    };
+    // Captures the live panes into `into`, reusing the effects of an earlier
+    // capture: effects that seek themselves keep the copy they first got,
+    // since seek() rebuilds them from the time, and the others are copied
+    // into their old copy. Only the first capture into a snapshot allocates.
+    void capture(Snapshot& into) const;
+    // Effects of panes that still exist are restored in place.
+    void restore(const Snapshot& snapshot);
+
+    // Warm start: the live panes with their schedules and effect state.
+    // save() fails if an effect cannot be saved. load() expects the panes of
+    // the same configuration, added in the same order; panes missing from
+    // the data had finished and are removed. Nothing changes unless every
+    // pane loads.
+    bool save(SnapshotWriter& out) const;
+    bool load(SnapshotReader& in);
+
+private:
+    struct Region {
+        int top{0};
+        int left{0};
+        unsigned int rows{0};
+        unsigned int cols{0};
+    };
+
+    struct Pane {
+        uint32_t id{0};
+        PaneConfig config{};
+        std::unique_ptr<Effect> effect{};
+        Region region{};
+        // Created on the first direct render of a partial-screen pane.
+        struct ncplane* plane{nullptr};
+        // Time since the last update, and updates skipped by the budget.
+        float pending{0.0f};
+        uint32_t tick{0};
+        // The pane updates on one in 2^throttle due frames.
+        uint8_t throttle{0};
+        // Starts a new compositor layer because it overlaps a pane below.
+        bool newLayer{true};
+        bool fullScreen{true};
+        bool finished{false};
+        // Budget bookkeeping, in milliseconds.
+        float frameCost{0.0f};
+        float smoothedCost{0.0f};
+        int overBudgetFrames{0};
+        int underBudgetFrames{0};
+    };
+
+    void insert(Pane pane);
+    Context pane_context(const Context& context, const Pane& pane) const;
+    struct ncplane* ensure_plane(Pane& pane);
+    void stack_planes();
+    static void observe_cost(Pane& pane);
+    void assign_layers();
+
+    std::vector<Pane> panes_{};
+    // Rectangles already used in the current layer; scratch for layout.
+    std::vector<Region> layer_regions_{};
+    struct ncplane* root_plane_{nullptr};
+    unsigned int rows_{0};
+    unsigned int cols_{0};
+    uint32_t next_id_{0};
+    bool layout_dirty_{true};
+};
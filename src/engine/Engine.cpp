@@ -2,9 +2,40 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <random>
+#include <string>
 #include <thread>
+#include <utility>
+
+#include <sys/resource.h>
+
+#include "utils/AllocationTracker.h"
+
+namespace {
+constexpr std::uint64_t kFramesPerSecond = 60;
+constexpr float kFixedFrameTime = 1.0f / kFramesPerSecond;
+// Two seconds.
+constexpr std::uint64_t kKeyframeInterval = 2 * kFramesPerSecond;
+constexpr std::size_t kMaxKeyframes = 32;
+// Seek steps for the arrow keys, in frames.
+constexpr std::uint64_t kSeekStep = kFramesPerSecond;
+constexpr std::uint64_t kSeekPageStep = 10 * kFramesPerSecond;
+// A held scene is still republished this often so new viewers can attach.
+constexpr long kIdleBroadcastIntervalNs = 250'000'000;
+// Upper bound on draw commands per cell before the DrawList has to grow.
+constexpr std::size_t kReservedCommandsPerCell = 2;
+// Warm-start snapshots. The version changes whenever the saved state of the
+// engine or of any effect does; the byte order and RNG size tell a snapshot
+// from another build apart.
+constexpr char kSnapshotMagic[8] = {'n', 'c', 'm', 's', 'n', 'a', 'p', '\0'};
+constexpr std::uint32_t kSnapshotVersion = 1;
+constexpr std::uint32_t kSnapshotByteOrder = 0x01020304U;
+} // namespace
 
 Engine::Engine() {
     notcurses_options opts = {0};
@@ -16,85 +47,562 @@ Engine::Engine() {
     }
 
     stdplane_ = notcurses_stdplane(nc_);
-    rng_ = std::mt19937(std::random_device{}());
+    seed_ = std::random_device{}();
+    rng_ = std::mt19937(seed_);
     context_.attach(nc_, stdplane_, &rng_);
     update_context_dimensions();
     last_frame_time_ = std::chrono::steady_clock::now();
 }
 
 Engine::~Engine() {
+    // Effects may own planes, which must be destroyed before notcurses stops.
+    effects_.clear();
+    log_governor_changes();
+    if (audio_ && audio_->sync_stats().frames > 0) {
+        const AudioAnalyzer::SyncStats& sync = audio_->sync_stats();
+        log_.push_back("audio sync: " + std::to_string(sync.frames) + " frames, analysis lags the scene clock by " +
+                       std::to_string(static_cast<int>(sync.lagSum / static_cast<double>(sync.frames) * 1000.0)) + " ms on average, " +
+                       std::to_string(static_cast<int>(sync.lagMax * 1000.0f)) + " ms at most");
+    }
     if (nc_ != nullptr) {
+        sample_output_stats();
         notcurses_stop(nc_);
     }
+    if (output_config_.reportStats) {
+        report_output_stats();
+    }
+    for (const auto& line : log_) {
+        std::cerr << "ncmatrix: " << line << '\n';
+    }
+    std::free(stats_);
+}
+
+void Engine::add_effect(std::unique_ptr<Effect> effect, const PaneConfig& pane) {
+    effects_.add(std::move(effect), pane);
+}
+
+void Engine::set_broadcast_server(std::unique_ptr<BroadcastServer> server) {
+    broadcast_ = std::move(server);
+}
+
+void Engine::set_frame_export(std::unique_ptr<FrameExport> frame_export) {
+    frame_export_ = std::move(frame_export);
+}
+
+void Engine::set_audio_analyzer(std::unique_ptr<AudioAnalyzer> analyzer) {
+    audio_ = std::move(analyzer);
+}
+
+void Engine::set_output_config(const OutputConfig& config) {
+    output_config_ = config;
+    if (output_config_.reportStats && stats_ == nullptr) {
+        stats_ = notcurses_stats_alloc(nc_);
+        notcurses_stats(nc_, stats_);
+        stats_sampled_ = OutputTally{stats_->renders, stats_->raster_bytes, stats_->fgemissions};
+    }
+    set_output_budget(output_config_.budgetEnabled);
 }
 
-void Engine::add_effect(std::unique_ptr<Effect> effect) {
-    if (effect) {
-        effects_.push_back(std::move(effect));
+void Engine::set_governor_config(const GovernorConfig& config) {
+    governor_ = QualityGovernor(config);
+    context_.quality = governor_.level().quality;
+    apply_output_settings();
+}
+
+void Engine::set_bloom_config(const BloomConfig& config) {
+    compositor_.set_bloom(config);
+}
+
+void Engine::set_raster_threads(unsigned int threads) {
+    compositor_.set_raster_threads(threads);
+}
+
+void Engine::set_output_budget(bool enabled) {
+    output_config_.budgetEnabled = enabled;
+    apply_output_settings();
+}
+
+void Engine::apply_output_settings() {
+    // The budget applies while the user enabled it or the governor needs it.
+    sample_output_stats();
+    output_reduced_ = output_config_.budgetEnabled || governor_.level().reducedColor;
+    context_.output = output_reduced_ ? output_config_.budget : OutputSettings{};
+}
+
+void Engine::observe_frame_time(float frame_ms) {
+    if (!governor_.observe(frame_ms)) {
+        return;
+    }
+    context_.quality = governor_.level().quality;
+    apply_output_settings();
+    governor_changes_[governor_change_count_ % kGovernorHistory] =
+        GovernorChange{context_.time, governor_.smoothed_ms(), governor_.level_index()};
+    governor_change_count_++;
+}
+
+void Engine::log_governor_changes() {
+    if (governor_change_count_ > kGovernorHistory) {
+        log_.push_back("quality level changed " + std::to_string(governor_change_count_) + " times; the last " +
+                       std::to_string(kGovernorHistory) + " were:");
+    }
+    const std::uint64_t first = governor_change_count_ > kGovernorHistory ? governor_change_count_ - kGovernorHistory : 0;
+    for (std::uint64_t change = first; change < governor_change_count_; ++change) {
+        const GovernorChange& entry = governor_changes_[change % kGovernorHistory];
+        char time[32];
+        std::snprintf(time, sizeof(time), "at %.1f s: ", entry.time);
+        log_.push_back(time + governor_.describe(entry.level, entry.frameMs));
     }
 }
 
+void Engine::sample_output_stats() {
+    if (stats_ == nullptr) {
+        return;
+    }
+
+    notcurses_stats(nc_, stats_);
+    const OutputTally current{stats_->renders, stats_->raster_bytes, stats_->fgemissions};
+    OutputTally& tally = output_tally_[output_reduced_ ? 1 : 0];
+    tally.frames += current.frames - stats_sampled_.frames;
+    tally.bytes += current.bytes - stats_sampled_.bytes;
+    tally.fgEmissions += current.fgEmissions - stats_sampled_.fgEmissions;
+    stats_sampled_ = current;
+}
+
+void Engine::report_output_stats() const {
+    static constexpr const char* kLabels[2] = {"full fidelity", "output budget"};
+    for (int mode = 0; mode < 2; ++mode) {
+        const OutputTally& tally = output_tally_[mode];
+        if (tally.frames == 0) {
+            continue;
+        }
+        std::cerr << "ncmatrix output (" << kLabels[mode] << "): " << tally.frames << " frames, "
+                  << tally.bytes / tally.frames << " bytes/frame, "
+                  << tally.fgEmissions / tally.frames << " fg color changes/frame\n";
+    }
+}
+
+void Engine::sample_stream_memory() {
+    const Effect::Footprint total = effects_.footprint();
+    if (total.bytes > stream_memory_.bytes) {
+        stream_memory_ = total;
+    }
+}
+
+std::string Engine::describe_stream_memory() const {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in KiB on Linux.
+    const double resident_mib = static_cast<double>(usage.ru_maxrss) / 1024.0;
+    const double per_stream = stream_memory_.streams == 0
+        ? 0.0
+        : static_cast<double>(stream_memory_.bytes) / static_cast<double>(stream_memory_.streams);
+    char line[160];
+    std::snprintf(line, sizeof(line), "stream memory: %zu streams, %.1f bytes/stream, %.1f KiB in total; peak resident %.1f MiB",
+                  stream_memory_.streams, per_stream, static_cast<double>(stream_memory_.bytes) / 1024.0, resident_mib);
+    return line;
+}
+
+void Engine::set_seed(std::uint32_t seed) {
+    seed_ = seed;
+    rng_.seed(seed);
+}
+
+void Engine::set_seekable(bool seekable) {
+    seekable_ = seekable;
+}
+
+void Engine::set_start_time(float seconds) {
+    start_time_ = std::min(std::max(0.0f, seconds), kMaxStartTime);
+}
+
+void Engine::set_snapshot_config(const SnapshotConfig& config) {
+    snapshot_config_ = config;
+    snapshot_file_.reset();
+    if (!snapshot_config_.path.empty()) {
+        snapshot_file_ = std::make_unique<SnapshotFile>(snapshot_config_.path);
+    }
+}
+
+void Engine::set_frame_limit(std::uint64_t frames) {
+    frame_limit_ = frames;
+}
+
 void Engine::run() {
     running_ = true;
     context_.deltaTime = 0.0f;
+    context_.time = 0.0f;
+    scene_frame_ = 0;
+    scene_seconds_ = 0.0;
+    context_.seed = seed_;
+    if (seekable_) {
+        if (effects_.all_clonable()) {
+            context_.seekable = true;
+            // The governor would make the scene depend on how fast frames were
+            // drawn, so seekable runs keep full quality.
+            governor_ = QualityGovernor{};
+            context_.quality = governor_.level().quality;
+            apply_output_settings();
+            keyframes_.resize(kMaxKeyframes);
+            keyframe_count_ = 0;
+            keyframe_interval_ = kKeyframeInterval;
+            seek_to(static_cast<std::uint64_t>(std::llround(static_cast<double>(start_time_) * kFramesPerSecond)));
+        } else {
+            log_.push_back("seeking disabled: an effect in this scene cannot be snapshotted");
+        }
+    }
+    if (snapshot_file_ && context_.seekable) {
+        // A seekable scene is defined by its time alone.
+        log_.push_back("snapshots disabled in seekable mode");
+        snapshot_file_.reset();
+    }
+    if (snapshot_file_) {
+        update_context_dimensions();
+        resume_from_snapshot();
+        // The first snapshot is taken on the first frame, which sizes the
+        // buffers while allocations are still expected.
+        last_snapshot_time_ = context_.time - snapshot_config_.interval;
+    }
+    if (context_.seekable && audio_) {
+        // A seek would need the analysis of audio that was never played.
+        log_.push_back("audio input ignored in seekable mode");
+        audio_.reset();
+    }
+
+    std::uint64_t frame = 0;
     while (running_) {
+        alloc_tracking::begin_frame(frame);
         const auto now = std::chrono::steady_clock::now();
-        context_.deltaTime = std::chrono::duration<float>(now - last_frame_time_).count();
+        if (context_.seekable) {
+            context_.deltaTime = (hold_frame_ || paused_) ? 0.0f : kFixedFrameTime;
+            hold_frame_ = false;
+            if (context_.deltaTime > 0.0f) {
+                set_scene_frame(scene_frame_ + 1);
+            }
+        } else {
+            context_.deltaTime = (frame_limit_ > 0) ? kFixedFrameTime : std::chrono::duration<float>(now - last_frame_time_).count();
+            scene_seconds_ += context_.deltaTime;
+            context_.time = static_cast<float>(scene_seconds_);
+        }
         last_frame_time_ = now;
+        if (audio_) {
+            audio_->poll(context_.time, context_.deltaTime, context_.audio, frame_limit_ > 0);
+        }
 
         update_context_dimensions();
 
-        remove_finished_effects();
+        effects_.update(context_);
+        if (frame_limit_ > 0) {
+            sample_stream_memory();
+        }
+        capture_keyframe_if_due();
 
-        for (const auto& effect : effects_) {
-            effect->update(context_);
+        // Effects that record draw commands are composited in one pass after
+        // any effects that still draw on the plane directly. Panes are drawn
+        // in z order, each overlapping pane on a new layer.
+        draw_list_.clear();
+        bool recorded = false;
+        bool drew_on_root = false;
+        effects_.draw(context_, draw_list_, recorded, drew_on_root);
+        if (recorded) {
+            compositor_.compose(draw_list_, context_, !drew_on_root);
+        }
+        effects_.collect();
+        if (frame == 0) {
+            prime_keyframes();
+        }
+        if (snapshot_file_ && context_.time - last_snapshot_time_ >= snapshot_config_.interval && !snapshot_file_->busy()) {
+            save_snapshot(false);
         }
 
-        remove_finished_effects();
+        notcurses_render(nc_);
+        if (broadcast_) {
+            broadcast_->publish(stdplane_);
+        }
+        if (frame_export_ && recorded &&
+            !frame_export_->publish(compositor_.frame(), context_.time, drew_on_root ? frame_ring::kPartial : 0U)) {
+            log_.push_back("frame export stopped: " + frame_export_->error());
+            frame_export_.reset();
+        }
+        if (governor_.enabled()) {
+            const auto frame_end = std::chrono::steady_clock::now();
+            observe_frame_time(std::chrono::duration<float, std::milli>(frame_end - now).count());
+        }
+        // Nothing will change until an event arrives, so block on input
+        // instead of drawing identical frames. Scripted runs never wait.
+        const bool idle = frame_limit_ == 0 && scene_is_static();
+        process_input(idle);
+        if (idle) {
+            last_frame_time_ = std::chrono::steady_clock::now();
+        }
+        alloc_tracking::end_frame();
 
-        for (const auto& effect : effects_) {
-            effect->render(context_);
+        ++frame;
+        if (frame_limit_ > 0) {
+            running_ = running_ && frame < frame_limit_;
+        } else if (!idle) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(16));
         }
+    }
+    if (frame_limit_ > 0) {
+        log_.push_back(describe_stream_memory());
+    }
+    if (snapshot_file_) {
+        save_snapshot(true);
+    }
+    if (snapshot_file_ && !snapshot_file_->error().empty()) {
+        log_.push_back("snapshot not saved: " + snapshot_file_->error());
+    }
+}
 
-        remove_finished_effects();
+bool Engine::encode_snapshot() {
+    SnapshotWriter& out = snapshot_writer_;
+    out.clear();
+    out.put(kSnapshotMagic);
+    out.put(kSnapshotVersion);
+    out.put(kSnapshotByteOrder);
+    out.put(static_cast<std::uint32_t>(sizeof(rng_)));
+    out.put(snapshot_config_.configDigest);
+    out.put(context_.rows);
+    out.put(context_.cols);
+    out.put(context_.time);
+    out.put(seed_);
+    out.put(rng_);
+    out.put(output_config_.budgetEnabled);
+    if (!effects_.save(out)) {
+        return false;
+    }
+    out.put(snapshot_hash(out.bytes()));
+    return true;
+}
 
-        notcurses_render(nc_);
-        process_input();
-        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+void Engine::save_snapshot(bool wait) {
+    last_snapshot_time_ = context_.time;
+    // Once every effect has finished, the last snapshot with something on
+    // screen is kept, so a restart plays the end of the scene again.
+    if (effects_.empty()) {
+        return;
+    }
+    if (!encode_snapshot()) {
+        log_.push_back("snapshots disabled: an effect in this scene cannot be saved");
+        snapshot_file_.reset();
+        return;
+    }
+    if (wait) {
+        snapshot_file_->flush();
+    }
+    snapshot_file_->submit(snapshot_writer_.bytes());
+    if (wait) {
+        snapshot_file_->flush();
+    }
+}
+
+void Engine::resume_from_snapshot() {
+    const auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    std::string error;
+    if (!file.open(snapshot_file_->path(), error)) {
+        if (!error.empty()) {
+            log_.push_back("snapshot ignored: " + error);
+        }
+        return;
+    }
+
+    const std::span<const std::uint8_t> bytes = file.bytes();
+    std::uint64_t checksum = 0;
+    if (bytes.size() < sizeof(checksum)) {
+        log_.push_back("snapshot ignored: the file is truncated");
+        return;
+    }
+    const std::span<const std::uint8_t> body = bytes.first(bytes.size() - sizeof(checksum));
+    std::memcpy(&checksum, bytes.data() + body.size(), sizeof(checksum));
+    if (checksum != snapshot_hash(body)) {
+        log_.push_back("snapshot ignored: the file is damaged");
+        return;
+    }
+
+    SnapshotReader in(body);
+    char magic[sizeof(kSnapshotMagic)]{};
+    std::uint32_t version = 0;
+    std::uint32_t byte_order = 0;
+    std::uint32_t rng_size = 0;
+    if (!in.get(magic) || std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0 || !in.get(version) ||
+        version != kSnapshotVersion || !in.get(byte_order) || byte_order != kSnapshotByteOrder || !in.get(rng_size) ||
+        rng_size != sizeof(rng_)) {
+        log_.push_back("snapshot ignored: written by another version of ncmatrix");
+        return;
+    }
+    std::uint64_t digest = 0;
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+    if (!in.get(digest) || digest != snapshot_config_.configDigest) {
+        log_.push_back("snapshot ignored: taken with another configuration");
+        return;
+    }
+    if (!in.get(rows) || !in.get(cols) || rows != context_.rows || cols != context_.cols) {
+        log_.push_back("snapshot ignored: taken at " + std::to_string(cols) + "x" + std::to_string(rows) + ", the screen is " +
+                       std::to_string(context_.cols) + "x" + std::to_string(context_.rows));
+        return;
+    }
+    float time = 0.0f;
+    std::uint32_t seed = 0;
+    std::mt19937 rng;
+    bool budget = false;
+    if (!in.get(time) || !in.get(seed) || !in.get(rng) || !in.get(budget) || !effects_.load(in) || in.remaining() != 0) {
+        log_.push_back("snapshot ignored: it does not match the scene");
+        return;
+    }
+
+    context_.time = time;
+    scene_seconds_ = time;
+    seed_ = seed;
+    context_.seed = seed;
+    rng_ = rng;
+    set_output_budget(budget);
+    const float elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    char line[96];
+    std::snprintf(line, sizeof(line), "resumed from snapshot at %.2f s of scene time in %.2f ms", time, elapsed_ms);
+    log_.push_back(line);
+}
+
+void Engine::capture_keyframe_if_due() {
+    if (!context_.seekable) {
+        return;
+    }
+    if (scene_frame_ < keyframe_count_ * keyframe_interval_) {
+        return;
+    }
+    if (keyframe_count_ == keyframes_.size()) {
+        // Keep the keyframes at even multiples of the interval. The dropped
+        // ones move to the free slots, where their storage is reused.
+        for (std::size_t index = 1; index < keyframe_count_ / 2; ++index) {
+            std::swap(keyframes_[index], keyframes_[index * 2]);
+        }
+        keyframe_count_ /= 2;
+        keyframe_interval_ *= 2;
+    }
+
+    Keyframe& keyframe = keyframes_[keyframe_count_++];
+    keyframe.frame = scene_frame_;
+    keyframe.rng = rng_;
+    effects_.capture(keyframe.panes);
+}
+
+void Engine::prime_keyframes() {
+    // Captures into the unused slots give them the storage of the current
+    // effects, now that a frame has been drawn and they have sized
+    // themselves, so that keyframes taken later copy into it.
+    if (!context_.seekable) {
+        return;
+    }
+    for (std::size_t index = keyframe_count_; index < keyframes_.size(); ++index) {
+        effects_.capture(keyframes_[index].panes);
     }
 }
 
+void Engine::set_scene_frame(std::uint64_t frame) {
+    scene_frame_ = frame;
+    context_.time = static_cast<float>(static_cast<double>(frame) / kFramesPerSecond);
+}
+
+void Engine::seek_to(std::uint64_t frame) {
+    // Restart from the latest keyframe at or before the target; the first
+    // call captures keyframe 0 from the freshly added effects.
+    capture_keyframe_if_due();
+    const auto used = keyframes_.begin() + static_cast<std::ptrdiff_t>(keyframe_count_);
+    auto keyframe = std::upper_bound(keyframes_.begin(), used, frame,
+                                     [](std::uint64_t target, const Keyframe& candidate) { return target < candidate.frame; });
+    if (keyframe != keyframes_.begin()) {
+        --keyframe;
+    }
+    if (keyframe->frame > scene_frame_ || frame < scene_frame_) {
+        effects_.restore(keyframe->panes);
+        rng_ = keyframe->rng;
+        set_scene_frame(keyframe->frame);
+    }
+
+    // Replay whole frames so the scene matches what playback would show at
+    // the same frame; effects that seek themselves are only evaluated once
+    // at the end.
+    update_context_dimensions();
+    context_.deltaTime = kFixedFrameTime;
+    while (scene_frame_ < frame) {
+        set_scene_frame(scene_frame_ + 1);
+        effects_.update(context_, true);
+        effects_.collect();
+        capture_keyframe_if_due();
+    }
+    context_.deltaTime = 0.0f;
+    effects_.seek(context_);
+    hold_frame_ = true;
+}
+
 void Engine::update_context_dimensions() {
     unsigned int rows = 0;
     unsigned int cols = 0;
     ncplane_dim_yx(stdplane_, &rows, &cols);
+    if (rows != context_.rows || cols != context_.cols) {
+        const std::size_t cells = static_cast<std::size_t>(rows) * cols;
+        draw_list_.reserve(cells * kReservedCommandsPerCell, cells);
+    }
     context_.rows = rows;
     context_.cols = cols;
+    effects_.layout(stdplane_, rows, cols);
+}
+
+bool Engine::scene_is_static() const {
+    if (context_.seekable && paused_ && !hold_frame_) {
+        return true;
+    }
+    return effects_.all_static();
 }
 
-void Engine::process_input() {
+void Engine::process_input(bool wait) {
     ncinput input;
-    timespec ts{0, 0};
+    const timespec poll{0, 0};
+    const timespec idle_broadcast{0, kIdleBroadcastIntervalNs};
+    const timespec* timeout = &poll;
+    if (wait) {
+        timeout = broadcast_ ? &idle_broadcast : nullptr;
+    }
 
     while (true) {
-        char32_t key = notcurses_get(nc_, &ts, &input);
+        char32_t key = notcurses_get(nc_, timeout, &input);
+        timeout = &poll;
         if (key == 0 || key == static_cast<char32_t>(-1)) {
             break;
         }
 
+        if (key == NCKEY_RESIZE) {
+            // Picks up the new size now, so the next frame lays out for it
+            // instead of repeating the held one.
+            notcurses_refresh(nc_, nullptr, nullptr);
+            continue;
+        }
+
         if (key == U'q' || key == U'Q') {
             running_ = false;
             break;
         }
-    }
-}
 
-void Engine::remove_finished_effects() {
-    const auto erase_begin = std::remove_if(
-        effects_.begin(),
-        effects_.end(),
-        [](const std::unique_ptr<Effect>& effect) {
-            return effect != nullptr && effect->isFinished();
-        });
-    effects_.erase(erase_begin, effects_.end());
+        if (key == U'b' || key == U'B') {
+            set_output_budget(!output_config_.budgetEnabled);
+        }
+
+        if (!context_.seekable) {
+            continue;
+        }
+        if (key == U' ') {
+            paused_ = !paused_;
+        } else if (key == NCKEY_LEFT) {
+            seek_to(scene_frame_ - std::min(scene_frame_, kSeekStep));
+        } else if (key == NCKEY_RIGHT) {
+            seek_to(scene_frame_ + kSeekStep);
+        } else if (key == NCKEY_DOWN || key == NCKEY_PGDOWN) {
+            seek_to(scene_frame_ - std::min(scene_frame_, kSeekPageStep));
+        } else if (key == NCKEY_UP || key == NCKEY_PGUP) {
+            seek_to(scene_frame_ + kSeekPageStep);
+        } else if (key == NCKEY_HOME) {
+            seek_to(0);
+        }
+    }
 }
@@ -1,33 +1,166 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <random>
+#include <string>
 #include <vector>
 
 #include <notcurses/notcurses.h>
 
+#include "AudioAnalyzer.h"
+#include "BroadcastServer.h"
+#include "Compositor.h"
 #include "Context.h"
+#include "DrawList.h"
 #include "Effect.h"
+#include "EffectManager.h"
+#include "FrameExport.h"
+#include "QualityGovernor.h"
+#include "SnapshotFile.h"
+#include "utils/SnapshotIo.h"
+
+struct OutputConfig {
+    // Settings applied while the output budget is active.
+    OutputSettings budget{8, true};
+    bool budgetEnabled{false};
+    // Print bytes/frame per output mode after shutdown.
+    bool reportStats{false};
+};
+
+struct SnapshotConfig {
+    // Warm start: the scene is saved here every `interval` seconds and on
+    // exit, and resumed from it at startup. Empty disables.
+    std::string path{};
+    float interval{5.0f};
+    // Identifies the configuration; a snapshot taken with another one, or on
+    // a screen of another size, is ignored.
+    std::uint64_t configDigest{0};
+};
 
 class Engine {
 public:
     Engine();
     ~Engine();
 
-    void add_effect(std::unique_ptr<Effect> effect);
+    // Adds an effect as a pane; the default pane covers the whole screen and
+    // updates every frame.
+    void add_effect(std::unique_ptr<Effect> effect, const PaneConfig& pane = {});
+    void set_broadcast_server(std::unique_ptr<BroadcastServer> server);
+    // A started export that receives every composited frame.
+    void set_frame_export(std::unique_ptr<FrameExport> frame_export);
+    // A started analyzer whose levels are passed to effects in Context::audio.
+    void set_audio_analyzer(std::unique_ptr<AudioAnalyzer> analyzer);
+    void set_output_config(const OutputConfig& config);
+    void set_governor_config(const GovernorConfig& config);
+    void set_bloom_config(const BloomConfig& config);
+    // Threads for rasterizing large frames; 0 uses all hardware threads.
+    void set_raster_threads(unsigned int threads);
+    // Scripted runs: a fixed RNG seed, and a frame limit that also switches to
+    // a fixed 1/60 s timestep without sleeping and reports stream memory on
+    // exit.
+    void set_seed(std::uint32_t seed);
+    void set_frame_limit(std::uint64_t frames);
+    // Seekable mode: a fixed 1/60 s timestep on a scene clock that can be
+    // moved with the arrow keys, starting at `start_time` seconds. Start
+    // times are clamped to [0, kMaxStartTime]; past it, the float scene time
+    // effects see can no longer keep 1/60 s steps apart.
+    static constexpr float kMaxStartTime = 131072.0f;
+    void set_seekable(bool seekable);
+    void set_start_time(float seconds);
+    void set_snapshot_config(const SnapshotConfig& config);
     void run();
 
 private:
     void update_context_dimensions();
-    void process_input();
-    void remove_finished_effects();
+    bool scene_is_static() const;
+    // Handles pending input. With `wait`, first blocks until an event arrives
+    // (or, while broadcasting, until the next idle republish).
+    void process_input(bool wait);
+    void capture_keyframe_if_due();
+    void prime_keyframes();
+    // Warm start. The encoded scene is the header fields below, the panes,
+    // and a checksum of everything before it.
+    bool encode_snapshot();
+    void save_snapshot(bool wait);
+    void resume_from_snapshot();
+    void seek_to(std::uint64_t frame);
+    void set_scene_frame(std::uint64_t frame);
+    void set_output_budget(bool enabled);
+    void apply_output_settings();
+    void observe_frame_time(float frame_ms);
+    void sample_output_stats();
+    void report_output_stats() const;
+    void log_governor_changes();
+    void sample_stream_memory();
+    std::string describe_stream_memory() const;
+
+    // Scene state at `frame`, restored by seek_to() before replaying forward.
+    struct Keyframe {
+        std::uint64_t frame{0};
+        std::mt19937 rng{};
+        EffectManager::Snapshot panes{};
+    };
+
+    struct OutputTally {
+        std::uint64_t frames{0};
+        std::uint64_t bytes{0};
+        std::uint64_t fgEmissions{0};
+    };
 
     struct notcurses* nc_{nullptr};
     struct ncplane* stdplane_{nullptr};
     Context context_{};
-    std::vector<std::unique_ptr<Effect>> effects_{};
+    EffectManager effects_{};
+    DrawList draw_list_{};
+    Compositor compositor_{};
+    std::unique_ptr<BroadcastServer> broadcast_{};
+    std::unique_ptr<FrameExport> frame_export_{};
+    std::unique_ptr<AudioAnalyzer> audio_{};
+    OutputConfig output_config_{};
+    ncstats* stats_{nullptr};
+    OutputTally stats_sampled_{};
+    OutputTally output_tally_[2]{};
+    bool output_reduced_{false};
+    QualityGovernor governor_{};
+    // Governor level changes, logged on exit: the total, and the latest few
+    // in a ring so that a run flipping levels for days does not allocate.
+    struct GovernorChange {
+        float time{0.0f};
+        float frameMs{0.0f};
+        std::size_t level{0};
+    };
+    static constexpr std::size_t kGovernorHistory = 8;
+    std::array<GovernorChange, kGovernorHistory> governor_changes_{};
+    std::uint64_t governor_change_count_{0};
+    std::vector<std::string> log_{};
     std::mt19937 rng_{};
+    std::uint32_t seed_{0};
     bool running_{false};
+    bool seekable_{false};
+    bool paused_{false};
+    // Set by a seek so the target frame is shown before time moves again.
+    bool hold_frame_{false};
+    float start_time_{0.0f};
+    // The scene clock. Context::time is derived from these instead of being
+    // summed in float, where adding a frame's time stops changing it after
+    // a few days: a frame count on the fixed timestep of a seekable run, and
+    // seconds otherwise.
+    std::uint64_t scene_frame_{0};
+    double scene_seconds_{0.0};
+    // Fixed slots, filled up front; once all are used every other keyframe
+    // is dropped and the interval, in frames, doubles.
+    std::vector<Keyframe> keyframes_{};
+    std::size_t keyframe_count_{0};
+    std::uint64_t keyframe_interval_{0};
+    SnapshotConfig snapshot_config_{};
+    std::unique_ptr<SnapshotFile> snapshot_file_{};
+    SnapshotWriter snapshot_writer_{};
+    float last_snapshot_time_{0.0f};
+    std::uint64_t frame_limit_{0};
+    // Largest per-stream state held by the effects during a scripted run.
+    Effect::Footprint stream_memory_{};
     std::chrono::steady_clock::time_point last_frame_time_{};
 };
@@ -0,0 +1,163 @@
+#include "FrameExport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Room for a 240x80 screen up front, so ordinary resizes keep the segment.
+constexpr std::uint32_t kMinCapacity = 240 * 80;
+
+std::string system_error(const std::string& what, const std::string& name) {
+    return what + " '" + name + "': " + std::strerror(errno);
+}
+
+// Whether `name` is a live segment of another running producer.
+bool segment_in_use(const std::string& name, pid_t& owner) {
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info {};
+    bool in_use = false;
+    if (::fstat(fd, &info) == 0 && static_cast<std::size_t>(info.st_size) >= sizeof(frame_ring::Header)) {
+        void* data = ::mmap(nullptr, sizeof(frame_ring::Header), PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            const auto* header = static_cast<const frame_ring::Header*>(data);
+            owner = static_cast<pid_t>(header->producerPid);
+            in_use = std::memcmp(header->magic, frame_ring::kMagic, sizeof(frame_ring::kMagic)) == 0 &&
+                     header->retired.load(std::memory_order_acquire) == 0 && owner != ::getpid() &&
+                     (::kill(owner, 0) == 0 || errno == EPERM);
+            ::munmap(data, sizeof(frame_ring::Header));
+        }
+    }
+    ::close(fd);
+    return in_use;
+}
+} // namespace
+
+FrameExport::FrameExport(std::string name)
+    : name_(name.starts_with('/') ? std::move(name) : "/" + name) {}
+
+FrameExport::~FrameExport() {
+    release_segment();
+}
+
+bool FrameExport::start(std::string& error) {
+    pid_t owner = 0;
+    if (segment_in_use(name_, owner)) {
+        error = "shared memory '" + name_ + "' is in use by process " + std::to_string(owner);
+        return false;
+    }
+    // A segment left by a producer that crashed is replaced.
+    ::shm_unlink(name_.c_str());
+    if (!create_segment(kMinCapacity)) {
+        error = error_;
+        return false;
+    }
+    return true;
+}
+
+bool FrameExport::create_segment(std::uint32_t capacity) {
+    const std::size_t size = frame_ring::segment_bytes(capacity);
+    const int fd = ::shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error_ = system_error("cannot create shared memory", name_);
+        return false;
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        error_ = system_error("cannot size shared memory", name_);
+        ::close(fd);
+        ::shm_unlink(name_.c_str());
+        return false;
+    }
+    void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error_ = system_error("cannot map shared memory", name_);
+        ::shm_unlink(name_.c_str());
+        return false;
+    }
+
+    // The new segment is zero-filled, so every slot reads as empty. Readers
+    // check the magic last, once the layout fields are in place.
+    segment_ = static_cast<unsigned char*>(data);
+    segment_size_ = size;
+    capacity_ = capacity;
+    auto* header = new (segment_) frame_ring::Header{};
+    header->version = frame_ring::kVersion;
+    header->slots = frame_ring::kSlots;
+    header->capacity = capacity;
+    header->producerPid = static_cast<std::uint32_t>(::getpid());
+    header->slotBytes = frame_ring::slot_bytes(capacity);
+    header->latest.store(sequence_, std::memory_order_relaxed);
+    for (std::uint32_t slot = 0; slot < frame_ring::kSlots; ++slot) {
+        new (segment_ + frame_ring::slot_offset(slot, capacity)) frame_ring::SlotHeader{};
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, frame_ring::kMagic, sizeof(frame_ring::kMagic));
+    return true;
+}
+
+void FrameExport::release_segment() {
+    if (segment_ == nullptr) {
+        return;
+    }
+    // Readers see the flag before the name disappears.
+    reinterpret_cast<frame_ring::Header*>(segment_)->retired.store(1, std::memory_order_release);
+    ::shm_unlink(name_.c_str());
+    ::munmap(segment_, segment_size_);
+    segment_ = nullptr;
+    segment_size_ = 0;
+}
+
+bool FrameExport::publish(const Framebuffer& frame, float time, std::uint32_t flags) {
+    const std::size_t cells = frame.size();
+    if (cells > capacity_) {
+        // Grows in steps of half again, so a drag-resize does not replace
+        // the segment on every frame.
+        const std::size_t grown = std::max<std::size_t>(cells, static_cast<std::size_t>(capacity_) * 3 / 2);
+        release_segment();
+        if (grown > UINT32_MAX || !create_segment(static_cast<std::uint32_t>(grown))) {
+            if (error_.empty()) {
+                error_ = "frame too large for shared memory '" + name_ + "'";
+            }
+            return false;
+        }
+    }
+    if (segment_ == nullptr) {
+        return false;
+    }
+
+    const std::uint64_t sequence = ++sequence_;
+    unsigned char* slot = segment_ + frame_ring::slot_offset(sequence, capacity_);
+    auto* slot_header = reinterpret_cast<frame_ring::SlotHeader*>(slot);
+    slot_header->sequence.store(frame_ring::kWriting, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot_header->rows = frame.rows;
+    slot_header->cols = frame.cols;
+    slot_header->flags = flags;
+    slot_header->time = time;
+    if (cells > 0) {
+        std::memcpy(slot + frame_ring::glyphs_offset(), frame.glyphs.data(), cells * sizeof(char32_t));
+        std::memcpy(slot + frame_ring::red_offset(capacity_), frame.r.data(), cells);
+        std::memcpy(slot + frame_ring::green_offset(capacity_), frame.g.data(), cells);
+        std::memcpy(slot + frame_ring::blue_offset(capacity_), frame.b.data(), cells);
+        std::memcpy(slot + frame_ring::alpha_offset(capacity_), frame.alpha.data(), cells);
+        std::memcpy(slot + frame_ring::style_offset(capacity_), frame.styles.data(), cells);
+    }
+
+    slot_header->sequence.store(sequence, std::memory_order_release);
+    reinterpret_cast<frame_ring::Header*>(segment_)->latest.store(sequence, std::memory_order_release);
+    return true;
+}
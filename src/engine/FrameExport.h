@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Framebuffer.h"
+#include "FrameRing.h"
+
+// Publishes each composited frame into a POSIX shared-memory ring (see
+// FrameRing.h) for local tools such as recorders or LED-wall drivers. Readers
+// map the segment and read frames in place; publishing is a copy of the cell
+// planes into the next slot with no system calls, except when a larger screen
+// needs a new segment.
+class FrameExport {
+public:
+    // `name` is the shm_open() name; a leading '/' is added if missing.
+    explicit FrameExport(std::string name);
+    // Retires and unlinks the segment.
+    ~FrameExport();
+
+    FrameExport(const FrameExport&) = delete;
+    FrameExport& operator=(const FrameExport&) = delete;
+
+    // Fails if the name is used by another running producer.
+    bool start(std::string& error);
+    // Fails, with error() set, if a larger segment cannot be created.
+    bool publish(const Framebuffer& frame, float time, std::uint32_t flags);
+    const std::string& name() const { return name_; }
+    const std::string& error() const { return error_; }
+
+private:
+    bool create_segment(std::uint32_t capacity);
+    void release_segment();
+
+    std::string name_;
+    std::string error_{};
+    unsigned char* segment_{nullptr};
+    std::size_t segment_size_{0};
+    std::uint32_t capacity_{0};
+    std::uint64_t sequence_{0};
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the shared-memory frame ring written by FrameExport. The segment
+// is a Header followed by kSlots slots. Each slot has a SlotHeader and then
+// the cell planes of one frame, in the Framebuffer's layout: code points
+// (uint32), then red, green, blue, alpha and style bytes (NCSTYLE_* bits).
+// Each plane holds `capacity` cells, of which the first rows * cols are
+// used, row by row. A cell with zero alpha is empty.
+//
+// The producer writes frame n into slot n % kSlots and never waits for
+// readers. While a slot is being written its sequence is kWriting; once the
+// frame is complete the slot's sequence is set to n and then Header::latest.
+// A reader takes latest, reads the slot in place, and keeps what it read
+// only if the slot's sequence is still n afterwards.
+//
+// A segment is never resized. When the screen outgrows it, or the producer
+// exits, the producer sets Header::retired and unlinks the name; a new
+// segment may then appear under the same name.
+namespace frame_ring {
+
+constexpr char kMagic[8] = {'n', 'c', 'm', 'f', 'r', 'a', 'm', 'e'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kSlots = 4;
+constexpr std::uint64_t kWriting = ~std::uint64_t{0};
+constexpr std::size_t kAlignment = 64;
+
+enum Flags : std::uint32_t {
+    // A full-screen effect that renders straight to the terminal (pixel
+    // rain) drew this frame too; its cells are missing.
+    kPartial = 1U << 0U,
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the ring needs lock-free 64-bit atomics");
+static_assert(sizeof(char32_t) == sizeof(std::uint32_t));
+
+struct alignas(kAlignment) Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t slots;
+    std::uint32_t producerPid;
+    // Cells per slot, and the distance between slots in bytes.
+    std::uint32_t capacity;
+    std::uint64_t slotBytes;
+    // Sequence of the newest complete frame, starting at 1; 0 before the
+    // first frame.
+    std::atomic<std::uint64_t> latest;
+    std::atomic<std::uint32_t> retired;
+};
+
+struct alignas(kAlignment) SlotHeader {
+    std::atomic<std::uint64_t> sequence;
+    std::uint32_t rows;
+    std::uint32_t cols;
+    std::uint32_t flags;
+    // Scene time of the frame in seconds.
+    float time;
+};
+
+constexpr std::size_t align(std::size_t bytes) {
+    return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Offsets of the planes from the start of a slot.
+constexpr std::size_t glyphs_offset() {
+    return sizeof(SlotHeader);
+}
+constexpr std::size_t channel_offset(std::uint32_t capacity, unsigned int channel) {
+    return glyphs_offset() + align(std::size_t{capacity} * sizeof(std::uint32_t)) + channel * align(capacity);
+}
+constexpr std::size_t red_offset(std::uint32_t capacity) { return channel_offset(capacity, 0); }
+constexpr std::size_t green_offset(std::uint32_t capacity) { return channel_offset(capacity, 1); }
+constexpr std::size_t blue_offset(std::uint32_t capacity) { return channel_offset(capacity, 2); }
+constexpr std::size_t alpha_offset(std::uint32_t capacity) { return channel_offset(capacity, 3); }
+constexpr std::size_t style_offset(std::uint32_t capacity) { return channel_offset(capacity, 4); }
+constexpr std::size_t slot_bytes(std::uint32_t capacity) { return channel_offset(capacity, 5); }
+
+constexpr std::size_t segment_bytes(std::uint32_t capacity) {
+    return sizeof(Header) + kSlots * slot_bytes(capacity);
+}
+
+constexpr std::size_t slot_offset(std::uint64_t sequence, std::uint32_t capacity) {
+    return sizeof(Header) + static_cast<std::size_t>(sequence % kSlots) * slot_bytes(capacity);
+}
+
+} // namespace frame_ring
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utils/Color.h"
+
+// Flat cell grid the Compositor resolves draw commands into before anything
+// touches a plane. Channels are stored as separate planes so blending can run
+// over many cells at once. A cell with zero alpha is empty. `glow` is only
+// meaningful while a Bloom pass fills it.
+struct Framebuffer {
+    unsigned int rows{0};
+    unsigned int cols{0};
+    std::vector<char32_t> glyphs{};
+    std::vector<uint8_t> r{};
+    std::vector<uint8_t> g{};
+    std::vector<uint8_t> b{};
+    std::vector<uint8_t> alpha{};
+    std::vector<uint8_t> styles{};
+    std::vector<uint8_t> glow{};
+
+    void resize(unsigned int new_rows, unsigned int new_cols) {
+        rows = new_rows;
+        cols = new_cols;
+        const std::size_t cells = size();
+        glyphs.resize(cells);
+        r.resize(cells);
+        g.resize(cells);
+        b.resize(cells);
+        alpha.resize(cells);
+        styles.resize(cells);
+        glow.resize(cells);
+    }
+
+    void clear() {
+        std::fill(alpha.begin(), alpha.end(), uint8_t{0});
+    }
+
+    std::size_t size() const {
+        return static_cast<std::size_t>(rows) * cols;
+    }
+
+    std::size_t index(unsigned int y, unsigned int x) const {
+        return static_cast<std::size_t>(y) * cols + x;
+    }
+
+    color::Rgb fg(std::size_t cell) const {
+        return color::Rgb{r[cell], g[cell], b[cell]};
+    }
+
+    void set(unsigned int y, unsigned int x, char32_t glyph, color::Rgb color, uint8_t cell_alpha, uint8_t style) {
+        const std::size_t cell = index(y, x);
+        glyphs[cell] = glyph;
+        r[cell] = color.r;
+        g[cell] = color.g;
+        b[cell] = color.b;
+        alpha[cell] = cell_alpha;
+        styles[cell] = style;
+    }
+};
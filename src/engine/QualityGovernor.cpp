@@ -0,0 +1,69 @@
+#include "QualityGovernor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+namespace {
+constexpr float kSmoothing = 0.1f;
+
+// Cheapest wins first: shimmer, then trail length, then stream count, and
+// finally color depth.
+constexpr QualityGovernor::Level kLadder[] = {
+    {{1.0f, 1.0f, 1.0f}, false},
+    {{1.0f, 1.0f, 0.5f}, false},
+    {{1.0f, 0.75f, 0.5f}, false},
+    {{0.75f, 0.75f, 0.25f}, false},
+    {{0.75f, 0.6f, 0.25f}, true},
+    {{0.5f, 0.5f, 0.25f}, true},
+};
+constexpr std::size_t kLevelCount = std::size(kLadder);
+} // namespace
+
+QualityGovernor::QualityGovernor(GovernorConfig config)
+    : config_(config) {}
+
+const QualityGovernor::Level& QualityGovernor::level() const {
+    return kLadder[level_index_];
+}
+
+bool QualityGovernor::observe(float frame_ms) {
+    if (!enabled()) {
+        return false;
+    }
+
+    smoothed_ms_ = (smoothed_ms_ == 0.0f) ? frame_ms : smoothed_ms_ + kSmoothing * (frame_ms - smoothed_ms_);
+
+    if (smoothed_ms_ > config_.frameBudgetMs) {
+        over_budget_frames_++;
+        under_budget_frames_ = 0;
+    } else if (smoothed_ms_ < config_.frameBudgetMs * config_.recoverRatio) {
+        under_budget_frames_++;
+        over_budget_frames_ = 0;
+    } else {
+        over_budget_frames_ = 0;
+        under_budget_frames_ = 0;
+    }
+
+    if (over_budget_frames_ >= config_.degradeFrames && level_index_ + 1 < kLevelCount) {
+        level_index_++;
+        over_budget_frames_ = 0;
+        return true;
+    }
+    if (under_budget_frames_ >= config_.recoverFrames && level_index_ > 0) {
+        level_index_--;
+        under_budget_frames_ = 0;
+        return true;
+    }
+    return false;
+}
+
+std::string QualityGovernor::describe(std::size_t level, float frame_ms) const {
+    const Level& current = kLadder[std::min(level, kLevelCount - 1)];
+    char line[160];
+    std::snprintf(line, sizeof(line),
+                  "quality level %zu (frame %.2f ms, budget %.2f ms): density x%.2f, trail x%.2f, shimmer x%.2f, %s color",
+                  level, frame_ms, config_.frameBudgetMs, current.quality.density,
+                  current.quality.trailLength, current.quality.shimmer, current.reducedColor ? "reduced" : "full");
+    return line;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "Context.h"
+
+struct GovernorConfig {
+    // Target for update + render + output time per frame; 0 disables the governor.
+    float frameBudgetMs{0.0f};
+    // Frames the smoothed frame time must stay over budget before degrading.
+    int degradeFrames{30};
+    // Frames it must stay under `recoverRatio` of the budget before recovering.
+    int recoverFrames{120};
+    float recoverRatio{0.6f};
+};
+
+// Steps scene quality down a fixed ladder while frames run over budget and
+// back up once there is comfortable headroom again.
+class QualityGovernor {
+public:
+    struct Level {
+        QualitySettings quality{};
+        bool reducedColor{false};
+    };
+
+    explicit QualityGovernor(GovernorConfig config = {});
+
+    bool enabled() const { return config_.frameBudgetMs > 0.0f; }
+    // Feeds one measured frame time; returns true when the level changed.
+    bool observe(float frame_ms);
+
+    const Level& level() const;
+    std::size_t level_index() const { return level_index_; }
+    float smoothed_ms() const { return smoothed_ms_; }
+    // One line on `level` as reached with a smoothed frame time of `frame_ms`.
+    std::string describe(std::size_t level, float frame_ms) const;
+
+private:
+    GovernorConfig config_;
+    std::size_t level_index_{0};
+    float smoothed_ms_{0.0f};
+    int over_budget_frames_{0};
+    int under_budget_frames_{0};
+};
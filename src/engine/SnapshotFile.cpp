@@ -0,0 +1,145 @@
+#include "SnapshotFile.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+bool write_file(const std::string& path, const std::string& temp_path, const std::vector<uint8_t>& bytes, std::string& error) {
+    const int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "cannot create '" + temp_path + "': " + std::strerror(errno);
+        return false;
+    }
+    std::size_t written = 0;
+    while (written < bytes.size()) {
+        const ssize_t result = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            error = "cannot write '" + temp_path + "': " + std::strerror(errno);
+            ::close(fd);
+            ::unlink(temp_path.c_str());
+            return false;
+        }
+        written += static_cast<std::size_t>(result);
+    }
+    // The data must be on disk before the rename makes it the snapshot.
+    if (::fsync(fd) != 0) {
+        error = "cannot flush '" + temp_path + "': " + std::strerror(errno);
+        ::close(fd);
+        ::unlink(temp_path.c_str());
+        return false;
+    }
+    ::close(fd);
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        error = "cannot replace '" + path + "': " + std::strerror(errno);
+        ::unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+SnapshotFile::SnapshotFile(std::string path)
+    : path_(std::move(path)),
+      temp_path_(path_ + ".tmp") {
+    thread_ = std::thread([this] { run(); });
+}
+
+SnapshotFile::~SnapshotFile() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool SnapshotFile::submit(std::span<const uint8_t> bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_) {
+            return false;
+        }
+        buffer_.assign(bytes.begin(), bytes.end());
+        pending_ = true;
+    }
+    wake_.notify_one();
+    return true;
+}
+
+bool SnapshotFile::busy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+void SnapshotFile::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return !pending_; });
+}
+
+std::string SnapshotFile::error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+void SnapshotFile::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return pending_ || stop_; });
+        if (!pending_) {
+            return;
+        }
+        // The buffer is not touched by submit() while a write is pending.
+        lock.unlock();
+        std::string error;
+        const bool ok = write_file(path_, temp_path_, buffer_, error);
+        lock.lock();
+        if (!ok && error_.empty()) {
+            error_ = std::move(error);
+        }
+        pending_ = false;
+        idle_.notify_all();
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            error = "cannot open '" + path + "': " + std::strerror(errno);
+        }
+        return false;
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        error = "'" + path + "' is empty or unreadable";
+        ::close(fd);
+        return false;
+    }
+    void* data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        error = "cannot map '" + path + "': " + std::strerror(errno);
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = static_cast<std::size_t>(info.st_size);
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Warm-start snapshot on disk. A write goes to a temporary file next to the
+// snapshot, is flushed to disk and renamed over it, so a crash or power cut
+// leaves either the previous snapshot or the new one, never a mix. Writes run
+// on a background thread, so the render loop only pays for encoding the
+// scene into memory.
+class SnapshotFile {
+public:
+    explicit SnapshotFile(std::string path);
+    // Finishes a write in progress.
+    ~SnapshotFile();
+
+    SnapshotFile(const SnapshotFile&) = delete;
+    SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+    const std::string& path() const { return path_; }
+
+    // Copies `bytes` for the writer thread into a buffer that is kept
+    // between writes. Returns false while the previous write is still busy.
+    bool submit(std::span<const uint8_t> bytes);
+    // Whether the previous write is still running.
+    bool busy() const;
+    // Waits until the submitted write is on disk.
+    void flush();
+    // The first write error, or an empty string.
+    std::string error() const;
+
+private:
+    void run();
+
+    std::string path_;
+    std::string temp_path_;
+    mutable std::mutex mutex_{};
+    std::condition_variable wake_{};
+    std::condition_variable idle_{};
+    std::vector<uint8_t> buffer_{};
+    bool pending_{false};
+    bool stop_{false};
+    std::string error_{};
+    std::thread thread_{};
+};
+
+// A file mapped read-only for as long as the object lives.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Fails with `error` set, or with it empty if the file does not exist.
+    bool open(const std::string& path, std::string& error);
+    std::span<const uint8_t> bytes() const { return {data_, size_}; }
+
+private:
+    const uint8_t* data_{nullptr};
+    std::size_t size_{0};
+};
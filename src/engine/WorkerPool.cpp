@@ -0,0 +1,89 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::resize(unsigned int threads) {
+    if (threads == 0) {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    if (threads == this->threads()) {
+        return;
+    }
+
+    stop();
+    stopping_ = false;
+    workers_.reserve(threads - 1U);
+    for (unsigned int i = 1; i < threads; ++i) {
+        workers_.emplace_back([this] { work_loop(); });
+    }
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+}
+
+void WorkerPool::dispatch(std::size_t tasks, void* callable, Invoke invoke) {
+    if (tasks == 0) {
+        return;
+    }
+    if (workers_.empty() || tasks == 1) {
+        for (std::size_t task = 0; task < tasks; ++task) {
+            invoke(callable, task);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callable_ = callable;
+        invoke_ = invoke;
+        tasks_ = tasks;
+        next_task_.store(0, std::memory_order_relaxed);
+        pending_ = workers_.size() + 1U;
+        generation_++;
+    }
+    start_.notify_all();
+
+    drain();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void WorkerPool::work_loop() {
+    std::size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+        }
+        drain();
+    }
+}
+
+void WorkerPool::drain() {
+    for (std::size_t task = next_task_.fetch_add(1, std::memory_order_relaxed); task < tasks_;
+         task = next_task_.fetch_add(1, std::memory_order_relaxed)) {
+        invoke_(callable_, task);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) {
+        done_.notify_one();
+    }
+}
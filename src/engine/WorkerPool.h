@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that run the tasks of one parallel loop at a time.
+// `run` hands out task indices until all are taken, helps from the calling
+// thread, and returns once every task has finished. The callable is passed
+// by reference, so dispatching a loop does not allocate.
+class WorkerPool {
+public:
+    WorkerPool() = default;
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Total threads working on a loop, including the caller. 0 means one per
+    // hardware thread.
+    void resize(unsigned int threads);
+    unsigned int threads() const { return static_cast<unsigned int>(workers_.size()) + 1U; }
+
+    template <typename Fn>
+    void run(std::size_t tasks, Fn& fn) {
+        dispatch(tasks, &fn, [](void* callable, std::size_t task) { (*static_cast<Fn*>(callable))(task); });
+    }
+
+private:
+    using Invoke = void (*)(void*, std::size_t);
+
+    void dispatch(std::size_t tasks, void* callable, Invoke invoke);
+    void work_loop();
+    void drain();
+    void stop();
+
+    std::vector<std::thread> workers_{};
+    std::mutex mutex_{};
+    std::condition_variable start_{};
+    std::condition_variable done_{};
+    // Bumped for every loop so sleeping workers can tell a new one started.
+    std::size_t generation_{0};
+    bool stopping_{false};
+
+    void* callable_{nullptr};
+    Invoke invoke_{nullptr};
+    std::size_t tasks_{0};
+    std::atomic<std::size_t> next_task_{0};
+    std::size_t pending_{0};
+};
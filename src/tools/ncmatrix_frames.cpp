@@ -0,0 +1,227 @@
+// Reference reader for the shared-memory frame ring that `ncmatrix
+// --export-frames NAME` publishes. It follows the newest frame, reading each
+// one in place, and reports how many frames it saw, skipped or caught being
+// overwritten. With --dump it prints the last frame as plain text.
+
+#include "engine/FrameRing.h"
+#include "utils/Utf8.h"
+
+#include <cxxopts.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+std::atomic<bool> interrupted{false};
+
+void handle_signal(int /*signal*/) {
+    interrupted = true;
+}
+
+// A mapped segment; empty until a producer has published one.
+class Segment {
+public:
+    Segment() = default;
+    ~Segment() { close(); }
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    bool open(const std::string& name) {
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(frame_ring::Header)) {
+            ::close(fd);
+            return false;
+        }
+        void* data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        data_ = static_cast<const unsigned char*>(data);
+        size_ = static_cast<std::size_t>(info.st_size);
+
+        // A segment left behind by a producer that was killed is skipped
+        // until a new producer replaces it.
+        const frame_ring::Header& head = header();
+        const bool valid = std::memcmp(head.magic, frame_ring::kMagic, sizeof(frame_ring::kMagic)) == 0;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!valid || head.version != frame_ring::kVersion || head.slots != frame_ring::kSlots ||
+            head.slotBytes != frame_ring::slot_bytes(head.capacity) || size_ < frame_ring::segment_bytes(head.capacity) ||
+            !producer_alive()) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<unsigned char*>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    bool mapped() const { return data_ != nullptr; }
+    bool producer_alive() const {
+        return ::kill(static_cast<pid_t>(header().producerPid), 0) == 0 || errno != ESRCH;
+    }
+    const frame_ring::Header& header() const { return *reinterpret_cast<const frame_ring::Header*>(data_); }
+    const unsigned char* slot(std::uint64_t sequence) const {
+        return data_ + frame_ring::slot_offset(sequence, header().capacity);
+    }
+
+private:
+    const unsigned char* data_{nullptr};
+    std::size_t size_{0};
+};
+
+struct FrameSummary {
+    std::uint32_t rows{0};
+    std::uint32_t cols{0};
+    std::uint32_t flags{0};
+    float time{0.0f};
+    std::size_t litCells{0};
+};
+
+// Reads frame `sequence` in place. Fails if the producer has moved on to
+// that slot, in which case everything read is discarded; `text` is only
+// replaced by a frame that was read whole.
+bool read_frame(const Segment& segment, std::uint64_t sequence, FrameSummary& summary, std::string* text) {
+    const unsigned char* slot = segment.slot(sequence);
+    const auto& slot_header = *reinterpret_cast<const frame_ring::SlotHeader*>(slot);
+    if (slot_header.sequence.load(std::memory_order_acquire) != sequence) {
+        return false;
+    }
+
+    const std::uint32_t capacity = segment.header().capacity;
+    FrameSummary frame{slot_header.rows, slot_header.cols, slot_header.flags, slot_header.time, 0};
+    const std::size_t cells = std::size_t{frame.rows} * frame.cols;
+    if (cells > capacity) {
+        return false;
+    }
+    const auto* glyphs = reinterpret_cast<const std::uint32_t*>(slot + frame_ring::glyphs_offset());
+    const unsigned char* alpha = slot + frame_ring::alpha_offset(capacity);
+    for (std::size_t cell = 0; cell < cells; ++cell) {
+        frame.litCells += alpha[cell] != 0 ? 1U : 0U;
+    }
+    std::string frame_text;
+    if (text != nullptr) {
+        frame_text.reserve(cells + frame.rows);
+        char utf8_glyph[4];
+        for (std::size_t cell = 0; cell < cells; ++cell) {
+            const char32_t glyph = alpha[cell] != 0 ? static_cast<char32_t>(glyphs[cell]) : U' ';
+            frame_text.append(utf8_glyph, utf8::encode(glyph, utf8_glyph));
+            if ((cell + 1) % frame.cols == 0) {
+                frame_text.push_back('\n');
+            }
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot_header.sequence.load(std::memory_order_relaxed) != sequence) {
+        return false;
+    }
+    summary = frame;
+    if (text != nullptr) {
+        text->swap(frame_text);
+    }
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    cxxopts::Options options("ncmatrix-frames", "Read frames from an ncmatrix shared-memory export");
+    options.add_options()
+        ("name", "Shared-memory name given to ncmatrix --export-frames", cxxopts::value<std::string>())
+        ("frames", "Exit after reading this many frames", cxxopts::value<std::uint64_t>())
+        ("dump", "Print the last frame as text on exit")
+        ("h,help", "Print usage information");
+    options.parse_positional({"name"});
+    options.positional_help("NAME");
+
+    cxxopts::ParseResult result;
+    try {
+        result = options.parse(argc, argv);
+    } catch (const cxxopts::exceptions::exception& ex) {
+        std::cerr << "Failed to parse command line: " << ex.what() << '\n';
+        return 1;
+    }
+    if (result.count("help") || !result.count("name")) {
+        std::cout << options.help() << '\n';
+        return result.count("help") ? 0 : 1;
+    }
+
+    std::string name = result["name"].as<std::string>();
+    if (!name.starts_with('/')) {
+        name.insert(name.begin(), '/');
+    }
+    const std::uint64_t frame_limit = result.count("frames") ? result["frames"].as<std::uint64_t>() : 0;
+    const bool dump = result.count("dump") > 0;
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    Segment segment;
+    std::uint64_t last = 0;
+    std::uint64_t read = 0;
+    std::uint64_t skipped = 0;
+    std::uint64_t overwritten = 0;
+    FrameSummary summary{};
+    std::string text;
+    while (!interrupted && (frame_limit == 0 || read < frame_limit)) {
+        if (!segment.mapped() && !segment.open(name)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        const std::uint64_t latest = segment.header().latest.load(std::memory_order_acquire);
+        if (latest == last || latest == 0) {
+            if (segment.header().retired.load(std::memory_order_acquire) != 0 || !segment.producer_alive()) {
+                // The producer exited, was killed, or moved to a larger
+                // segment; wait for the next one under the same name.
+                segment.close();
+                last = 0;
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (!read_frame(segment, latest, summary, dump ? &text : nullptr)) {
+            overwritten++;
+            continue;
+        }
+        if (last != 0 && latest > last + 1) {
+            skipped += latest - last - 1;
+        }
+        last = latest;
+        read++;
+    }
+
+    if (dump && read > 0) {
+        std::cout << text;
+    }
+    std::cerr << "ncmatrix-frames: " << read << " frames read, " << skipped << " skipped, " << overwritten
+              << " overwritten while reading";
+    if (read > 0) {
+        std::cerr << "; last " << summary.cols << "x" << summary.rows << " at " << summary.time << " s, "
+                  << summary.litCells << " cells lit" << ((summary.flags & frame_ring::kPartial) != 0 ? ", partial" : "");
+    }
+    std::cerr << '\n';
+    return 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+// Weighted choice among n items in constant time (Walker's alias method).
+// Building splits the weights into n equal columns, each holding at most two
+// items: the column's own item with some probability and one alias for the
+// rest. A draw then picks a column and flips one biased coin, both taken from
+// the same 32 random bits. Without weights the table stays empty and a draw
+// is a single multiply.
+class AliasTable {
+public:
+    AliasTable() = default;
+
+    // `count` equally likely items.
+    explicit AliasTable(std::size_t count) : count_(count) {}
+
+    // One item per weight. Negative weights count as 0; if no weight is
+    // positive the items are equally likely.
+    explicit AliasTable(std::span<const float> weights) : count_(weights.size()) {
+        double total = 0.0;
+        bool uniform = true;
+        for (const float weight : weights) {
+            total += weight > 0.0f ? weight : 0.0f;
+            uniform = uniform && weight == weights.front();
+        }
+        if (uniform || total <= 0.0) {
+            return;
+        }
+
+        // Vose's variant: scale the weights so the average column is full,
+        // then let each overfull item top up one underfull column.
+        std::vector<double> scaled(count_);
+        std::vector<uint32_t> small;
+        std::vector<uint32_t> large;
+        for (std::size_t i = 0; i < count_; ++i) {
+            scaled[i] = (weights[i] > 0.0f ? weights[i] : 0.0) * static_cast<double>(count_) / total;
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        columns_.resize(count_);
+        while (!small.empty() && !large.empty()) {
+            const uint32_t under = small.back();
+            small.pop_back();
+            const uint32_t over = large.back();
+            columns_[under] = Column{threshold(scaled[under]), over};
+            scaled[over] -= 1.0 - scaled[under];
+            if (scaled[over] < 1.0) {
+                large.pop_back();
+                small.push_back(over);
+            }
+        }
+        // Whatever is left is full up to rounding; such a column aliases
+        // itself so the coin cannot matter.
+        for (const uint32_t item : large) {
+            columns_[item] = Column{0, item};
+        }
+        for (const uint32_t item : small) {
+            columns_[item] = Column{0, item};
+        }
+    }
+
+    std::size_t size() const { return count_; }
+    bool uniform() const { return columns_.empty(); }
+
+    // The item for 32 uniform random bits.
+    std::size_t pick(uint32_t bits) const {
+        const uint64_t scaled = static_cast<uint64_t>(bits) * count_;
+        const auto item = static_cast<std::size_t>(scaled >> 32U);
+        if (columns_.empty()) {
+            return item;
+        }
+        // The low half of the product is uniform within the column.
+        const Column& column = columns_[item];
+        return static_cast<uint32_t>(scaled) < column.threshold ? item : column.alias;
+    }
+
+    std::size_t sample(std::mt19937& rng) const { return pick(static_cast<uint32_t>(rng())); }
+
+    // Fills `out` with `count` draws, with the uniform case decided once.
+    template <typename Index>
+    void fill(Index* out, std::size_t count, std::mt19937& rng) const {
+        if (columns_.empty()) {
+            for (std::size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<Index>((static_cast<uint64_t>(static_cast<uint32_t>(rng())) * count_) >> 32U);
+            }
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            out[i] = static_cast<Index>(sample(rng));
+        }
+    }
+
+    std::size_t footprint() const { return columns_.capacity() * sizeof(Column); }
+
+private:
+    struct Column {
+        // The column's own item is kept when the coin is below this.
+        uint32_t threshold{0};
+        uint32_t alias{0};
+    };
+
+    static uint32_t threshold(double probability) {
+        return static_cast<uint32_t>(probability * 4294967296.0);
+    }
+
+    std::size_t count_{0};
+    std::vector<Column> columns_{};
+};
@@ -0,0 +1,167 @@
+#include "utils/AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <execinfo.h>
+
+namespace {
+// Frames before this one may allocate freely (first layout, pools, buffers).
+constexpr std::uint64_t kWarmupFrames = 1;
+constexpr int kMaxSites = 32;
+constexpr int kMaxDepth = 16;
+// Skips record() and the operator new overload itself.
+constexpr int kSkippedFrames = 2;
+
+struct Site {
+    void* frames[kMaxDepth];
+    int depth;
+    std::uint64_t frame;
+    std::size_t size;
+};
+
+std::atomic<bool> armed{false};
+std::atomic<std::uint64_t> frame_allocations{0};
+std::atomic<std::uint64_t> frame_frees{0};
+std::atomic<int> site_count{0};
+Site sites[kMaxSites];
+thread_local bool in_hook = false;
+
+std::uint64_t current_frame = 0;
+std::uint64_t checked_frames = 0;
+std::uint64_t violating_frames = 0;
+std::uint64_t total_allocations = 0;
+std::uint64_t total_frees = 0;
+bool backtrace_loaded = false;
+
+void record_allocation(std::size_t size) {
+    if (!armed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    frame_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (in_hook) {
+        return;
+    }
+    const int index = site_count.fetch_add(1, std::memory_order_relaxed);
+    if (index >= kMaxSites) {
+        return;
+    }
+    in_hook = true;
+    Site& site = sites[index];
+    site.depth = backtrace(site.frames, kMaxDepth);
+    site.frame = current_frame;
+    site.size = size;
+    in_hook = false;
+}
+
+void record_free(void* pointer) {
+    if (pointer != nullptr && armed.load(std::memory_order_relaxed)) {
+        frame_frees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void* allocate(std::size_t size) {
+    record_allocation(size);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* allocate_aligned(std::size_t size, std::align_val_t alignment) {
+    record_allocation(size);
+    const auto align = static_cast<std::size_t>(alignment);
+    const std::size_t rounded = ((size == 0 ? 1 : size) + align - 1) / align * align;
+    if (void* pointer = std::aligned_alloc(align, rounded)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void release(void* pointer) {
+    record_free(pointer);
+    std::free(pointer);
+}
+} // namespace
+
+namespace alloc_tracking {
+
+void begin_frame(std::uint64_t frame) {
+    if (!backtrace_loaded) {
+        // The first backtrace() call loads the unwinder, which allocates.
+        void* probe[1];
+        backtrace(probe, 1);
+        backtrace_loaded = true;
+    }
+    current_frame = frame;
+    frame_allocations.store(0, std::memory_order_relaxed);
+    frame_frees.store(0, std::memory_order_relaxed);
+    armed.store(frame >= kWarmupFrames, std::memory_order_relaxed);
+}
+
+void end_frame() {
+    if (!armed.exchange(false, std::memory_order_relaxed)) {
+        return;
+    }
+    const std::uint64_t allocations = frame_allocations.load(std::memory_order_relaxed);
+    checked_frames++;
+    total_allocations += allocations;
+    total_frees += frame_frees.load(std::memory_order_relaxed);
+    if (allocations > 0) {
+        violating_frames++;
+    }
+}
+
+bool report(std::ostream& out) {
+    out << "allocation check: " << checked_frames << " frames after warm-up, "
+        << violating_frames << " with allocations (" << total_allocations << " new, "
+        << total_frees << " delete)\n";
+
+    const int recorded = std::min(site_count.load(), kMaxSites);
+    for (int i = 0; i < recorded; ++i) {
+        const Site& site = sites[i];
+        out << "  frame " << site.frame << ": " << site.size << " bytes\n";
+        char** symbols = backtrace_symbols(site.frames, site.depth);
+        for (int depth = kSkippedFrames; symbols != nullptr && depth < site.depth; ++depth) {
+            out << "    " << symbols[depth] << '\n';
+        }
+        std::free(symbols);
+    }
+    return violating_frames == 0;
+}
+
+} // namespace alloc_tracking
+
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocate_aligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocate_aligned(size, alignment); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* pointer) noexcept { release(pointer); }
+void operator delete[](void* pointer) noexcept { release(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { release(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
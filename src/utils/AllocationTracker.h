@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// Per-frame heap allocation accounting. Builds configured with
+// -DNCMATRIX_ALLOC_TRACKING=ON replace the global operator new/delete and
+// record the call sites of any allocation made after the warm-up frame; in
+// regular builds every function here is a no-op.
+namespace alloc_tracking {
+
+#if defined(NCMATRIX_ALLOC_TRACKING)
+constexpr bool kEnabled = true;
+
+void begin_frame(std::uint64_t frame);
+void end_frame();
+// Prints a summary and the recorded call sites; returns true when no frame
+// after warm-up allocated.
+bool report(std::ostream& out);
+#else
+constexpr bool kEnabled = false;
+
+inline void begin_frame(std::uint64_t /*frame*/) {}
+inline void end_frame() {}
+inline bool report(std::ostream& /*out*/) { return true; }
+#endif
+
+} // namespace alloc_tracking
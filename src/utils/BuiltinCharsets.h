@@ -0,0 +1,191 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// Character sets from assets/chars/, compiled into the binary. The build
+// embeds each file as UTF-8 text (see cmake/EmbedCharsets.cmake); the tables
+// below decode it while compiling, so an invalid file fails the build and
+// selecting a set at startup costs no file I/O or decoding. Configs refer to
+// them as "builtin:<file name without .txt>". A line may end in a tab and a
+// weight, which applies to every glyph on that line (see load_character_set).
+namespace builtin_charsets {
+
+constexpr std::string_view kPrefix = "builtin:";
+
+namespace detail {
+constexpr std::size_t kInvalid = static_cast<std::size_t>(-1);
+
+// Parses the weight after a tab: digits with an optional fraction, up to
+// the end of the line. Returns false for anything else.
+constexpr bool parse_weight(std::string_view text, std::size_t& i, float& weight) {
+    double value = 0.0;
+    double scale = 0.0;
+    bool digits = false;
+    for (; i < text.size() && text[i] != '\n' && text[i] != '\r'; ++i) {
+        const char c = text[i];
+        if (c == '.' && scale == 0.0) {
+            scale = 1.0;
+        } else if (c >= '0' && c <= '9') {
+            if (scale > 0.0) {
+                scale /= 10.0;
+                value += (c - '0') * scale;
+            } else {
+                value = value * 10.0 + (c - '0');
+            }
+            digits = true;
+        } else {
+            return false;
+        }
+    }
+    weight = static_cast<float>(value);
+    return digits;
+}
+
+// Decodes `text` the way the runtime loader reads a character set file:
+// line breaks and a leading BOM are skipped, and a tab starts the weight of
+// the glyphs on its line. Writes the glyphs and their weights to `out` and
+// `weights` unless they are null, and returns the number of glyphs, or
+// kInvalid for malformed UTF-8 or weights.
+constexpr std::size_t decode(std::string_view text, char32_t* out, float* weights = nullptr) {
+    std::size_t count = 0;
+    std::size_t line_start = 0;
+    std::size_t i = text.starts_with("\xEF\xBB\xBF") ? 3 : 0;
+    while (i < text.size()) {
+        const auto byte = static_cast<unsigned char>(text[i]);
+        if (byte == '\n' || byte == '\r') {
+            line_start = count;
+            ++i;
+            continue;
+        }
+        if (byte == '\t') {
+            float weight = 1.0f;
+            ++i;
+            if (!parse_weight(text, i, weight)) {
+                return kInvalid;
+            }
+            for (std::size_t glyph = line_start; weights != nullptr && glyph < count; ++glyph) {
+                weights[glyph] = weight;
+            }
+            continue;
+        }
+
+        std::size_t additional = 0;
+        char32_t codepoint = 0;
+        char32_t min_value = 0;
+        if (byte <= 0x7FU) {
+            codepoint = byte;
+        } else if ((byte & 0xE0U) == 0xC0U) {
+            codepoint = byte & 0x1FU;
+            additional = 1;
+            min_value = 0x80U;
+        } else if ((byte & 0xF0U) == 0xE0U) {
+            codepoint = byte & 0x0FU;
+            additional = 2;
+            min_value = 0x800U;
+        } else if ((byte & 0xF8U) == 0xF0U) {
+            codepoint = byte & 0x07U;
+            additional = 3;
+            min_value = 0x10000U;
+        } else {
+            return kInvalid;
+        }
+        if (i + additional >= text.size()) {
+            return kInvalid;
+        }
+        for (std::size_t j = 1; j <= additional; ++j) {
+            const auto continuation = static_cast<unsigned char>(text[i + j]);
+            if ((continuation & 0xC0U) != 0x80U) {
+                return kInvalid;
+            }
+            codepoint = (codepoint << 6U) | (continuation & 0x3FU);
+        }
+        if (codepoint < min_value || codepoint > 0x10FFFFU || (codepoint >= 0xD800U && codepoint <= 0xDFFFU)) {
+            return kInvalid;
+        }
+
+        if (out != nullptr) {
+            out[count] = codepoint;
+        }
+        if (weights != nullptr) {
+            weights[count] = 1.0f;
+        }
+        ++count;
+        i += additional + 1;
+    }
+    return count;
+}
+
+// Table size for `text`; invalid text is reported by a static_assert, so
+// this only keeps the follow-on errors quiet.
+constexpr std::size_t table_size(std::string_view text) {
+    const std::size_t count = decode(text, nullptr);
+    return count == kInvalid ? 0 : count;
+}
+
+template <std::size_t N>
+constexpr std::array<char32_t, N> decode_table(std::string_view text) {
+    std::array<char32_t, N> table{};
+    decode(text, table.data());
+    return table;
+}
+
+template <std::size_t N>
+constexpr std::array<float, N> decode_weights(std::string_view text) {
+    std::array<float, N> weights{};
+    decode(text, nullptr, weights.data());
+    return weights;
+}
+
+#define NCMATRIX_CHARSET(id, name, text)                                                                  \
+    inline constexpr std::string_view id##_text = text;                                                   \
+    static_assert(decode(id##_text, nullptr) != kInvalid, "assets/chars/" name ".txt is not valid UTF-8 or has a bad weight"); \
+    static_assert(decode(id##_text, nullptr) > 0, "assets/chars/" name ".txt is empty");                  \
+    inline constexpr auto id##_glyphs = decode_table<table_size(id##_text)>(id##_text);                   \
+    inline constexpr auto id##_weights = decode_weights<table_size(id##_text)>(id##_text);
+#include "BuiltinCharsets.inc"
+#undef NCMATRIX_CHARSET
+} // namespace detail
+
+struct Charset {
+    std::string_view name;
+    std::span<const char32_t> glyphs;
+    // One per glyph; 1 unless the file gives a weight.
+    std::span<const float> weights;
+};
+
+#define NCMATRIX_CHARSET(id, name, text) Charset{name, detail::id##_glyphs, detail::id##_weights},
+inline constexpr Charset kAll[] = {
+#include "BuiltinCharsets.inc"
+};
+#undef NCMATRIX_CHARSET
+
+// The set named by `reference` ("builtin:<name>"), or null when it does not
+// name one.
+constexpr const Charset* lookup(std::string_view reference) {
+    if (!reference.starts_with(kPrefix)) {
+        return nullptr;
+    }
+    reference.remove_prefix(kPrefix.size());
+    for (const Charset& charset : kAll) {
+        if (charset.name == reference) {
+            return &charset;
+        }
+    }
+    return nullptr;
+}
+
+// The glyphs of the set named by `reference`, or an empty span.
+constexpr std::span<const char32_t> find(std::string_view reference) {
+    const Charset* charset = lookup(reference);
+    return charset != nullptr ? charset->glyphs : std::span<const char32_t>{};
+}
+
+constexpr bool is_reference(std::string_view value) {
+    return value.starts_with(kPrefix);
+}
+
+} // namespace builtin_charsets
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <notcurses/notcurses.h>
+
+namespace color {
+struct Rgb {
+    uint8_t r{0};
+    uint8_t g{0};
+    uint8_t b{0};
+
+    friend bool operator==(const Rgb&, const Rgb&) = default;
+};
+
+// Colors are configured as 0xRRGGBBAA.
+inline Rgb decode_rgba(uint32_t color) {
+    return Rgb{
+        static_cast<uint8_t>((color >> 24U) & 0xFFU),
+        static_cast<uint8_t>((color >> 16U) & 0xFFU),
+        static_cast<uint8_t>((color >> 8U) & 0xFFU),
+    };
+}
+
+inline uint8_t decode_alpha(uint32_t color) {
+    return static_cast<uint8_t>(color & 0xFFU);
+}
+
+// Snaps a brightness factor in [0, 1] to one of `levels` steps. Fewer distinct
+// colors lets the terminal writer elide more SGR sequences.
+inline float quantize(float brightness, int levels) {
+    brightness = std::clamp(brightness, 0.0f, 1.0f);
+    if (levels <= 0) {
+        return brightness;
+    }
+    const float steps = static_cast<float>(levels);
+    return std::round(brightness * steps) / steps;
+}
+
+inline Rgb scale(Rgb color, float brightness) {
+    return Rgb{
+        static_cast<uint8_t>(static_cast<float>(color.r) * brightness),
+        static_cast<uint8_t>(static_cast<float>(color.g) * brightness),
+        static_cast<uint8_t>(static_cast<float>(color.b) * brightness),
+    };
+}
+
+namespace detail {
+constexpr uint8_t kCubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+constexpr int nearest_cube_index(uint8_t value) {
+    return value < 48 ? 0 : (value < 115 ? 1 : (value - 35) / 40);
+}
+
+constexpr int distance_sq(int r0, int g0, int b0, int r1, int g1, int b1) {
+    return (r0 - r1) * (r0 - r1) + (g0 - g1) * (g0 - g1) + (b0 - b1) * (b0 - b1);
+}
+} // namespace detail
+
+// Nearest entry of the standard xterm 256-color palette (cube or gray ramp).
+constexpr unsigned to_xterm256(Rgb color) {
+    const int ri = detail::nearest_cube_index(color.r);
+    const int gi = detail::nearest_cube_index(color.g);
+    const int bi = detail::nearest_cube_index(color.b);
+    const int cube_distance = detail::distance_sq(
+        color.r, color.g, color.b, detail::kCubeLevels[ri], detail::kCubeLevels[gi], detail::kCubeLevels[bi]);
+
+    const int average = (color.r + color.g + color.b) / 3;
+    const int gray_index = average > 238 ? 23 : (average < 8 ? 0 : (average - 8) / 10);
+    const int gray = 8 + 10 * gray_index;
+    const int gray_distance = detail::distance_sq(color.r, color.g, color.b, gray, gray, gray);
+
+    if (gray_distance < cube_distance) {
+        return 232U + static_cast<unsigned>(gray_index);
+    }
+    return 16U + static_cast<unsigned>(36 * ri + 6 * gi + bi);
+}
+
+// Tracks the plane's current foreground, background and bold state so
+// repeated glyphs with the same pen skip redundant notcurses calls.
+class Pen {
+public:
+    explicit Pen(struct ncplane* plane, bool palette256 = false)
+        : plane_(plane), palette256_(palette256) {}
+
+    void set(Rgb color, bool bold) {
+        if (!valid_ || color != color_) {
+            if (palette256_) {
+                ncplane_set_fg_palindex(plane_, to_xterm256(color));
+            } else {
+                ncplane_set_fg_rgb8(plane_, color.r, color.g, color.b);
+            }
+            color_ = color;
+        }
+        if (!valid_ || bold != bold_) {
+            if (bold) {
+                ncplane_on_styles(plane_, NCSTYLE_BOLD);
+            } else {
+                ncplane_off_styles(plane_, NCSTYLE_BOLD);
+            }
+            bold_ = bold;
+        }
+        valid_ = true;
+    }
+
+    void set_background(Rgb color) {
+        if (bg_valid_ && !bg_default_ && color == bg_) {
+            return;
+        }
+        if (palette256_) {
+            ncplane_set_bg_palindex(plane_, to_xterm256(color));
+        } else {
+            ncplane_set_bg_rgb8(plane_, color.r, color.g, color.b);
+        }
+        bg_ = color;
+        bg_default_ = false;
+        bg_valid_ = true;
+    }
+
+    void reset_background() {
+        if (bg_valid_ && bg_default_) {
+            return;
+        }
+        ncplane_set_bg_default(plane_);
+        bg_default_ = true;
+        bg_valid_ = true;
+    }
+
+private:
+    struct ncplane* plane_{nullptr};
+    bool palette256_{false};
+    bool valid_{false};
+    Rgb color_{};
+    bool bold_{false};
+    bool bg_valid_{false};
+    bool bg_default_{true};
+    Rgb bg_{};
+};
+} // namespace color
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Stateless random numbers: every value is a hash of a key and a few
+// counters, so any draw can be recomputed for any point in time without
+// replaying the draws before it.
+namespace counter_rng {
+
+// SplitMix64 finalizer.
+constexpr std::uint64_t mix(std::uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27U)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31U);
+}
+
+constexpr std::uint64_t hash(std::uint64_t key, std::uint64_t a, std::uint64_t b = 0, std::uint64_t c = 0) {
+    return mix(mix(mix(key ^ mix(a)) ^ b) ^ c);
+}
+
+// Uniform in [0, 1).
+constexpr float unit(std::uint64_t bits) {
+    return static_cast<float>(bits >> 40U) * (1.0f / 16777216.0f);
+}
+
+constexpr float uniform(std::uint64_t bits, float low, float high) {
+    return low + (high - low) * unit(bits);
+}
+
+// Uniform in [low, high].
+constexpr int uniform_int(std::uint64_t bits, int low, int high) {
+    if (high <= low) {
+        return low;
+    }
+    const auto span = static_cast<std::uint64_t>(high - low) + 1U;
+    return low + static_cast<int>(bits % span);
+}
+
+} // namespace counter_rng
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct CurveKey {
+    float time{0.0f};
+    float value{0.0f};
+};
+
+// Keyframed parameter over time, sampled once into a table so evaluating it
+// every frame is an index and a lerp. Before the first key the first value
+// holds; after the last it holds (or, for a looping curve, starts over from
+// time 0). The table also stores the running integral, which turns a rate
+// curve into a position without stepping through every frame.
+class Curve {
+public:
+    static constexpr float kSampleRate = 60.0f;
+
+    Curve() = default;
+
+    Curve(std::vector<CurveKey> keys, bool loop, bool smooth) : loop_(loop) {
+        if (keys.empty()) {
+            return;
+        }
+        std::stable_sort(keys.begin(), keys.end(), [](const CurveKey& a, const CurveKey& b) { return a.time < b.time; });
+        // The table covers the keys rounded up to whole samples.
+        const float last = std::max(0.0f, keys.back().time);
+        const auto count = static_cast<std::size_t>(std::ceil(last * kSampleRate)) + 1U;
+        duration_ = static_cast<float>(count - 1U) / kSampleRate;
+        samples_.resize(count);
+
+        std::size_t key = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            const float time = std::min(last, static_cast<float>(i) / kSampleRate);
+            while (key + 1 < keys.size() && keys[key + 1].time <= time) {
+                ++key;
+            }
+            if (key + 1 == keys.size() || time <= keys[key].time) {
+                samples_[i] = keys[key].value;
+                continue;
+            }
+            const CurveKey& from = keys[key];
+            const CurveKey& to = keys[key + 1];
+            float t = (time - from.time) / (to.time - from.time);
+            if (smooth) {
+                t = t * t * (3.0f - 2.0f * t);
+            }
+            samples_[i] = from.value + (to.value - from.value) * t;
+        }
+        rebuild_integral();
+    }
+
+    bool empty() const { return samples_.empty(); }
+
+    float at(float time) const {
+        std::size_t index = 0;
+        float fraction = 0.0f;
+        locate(time, index, fraction);
+        if (index + 1 >= samples_.size()) {
+            return samples_.back();
+        }
+        return samples_[index] + (samples_[index + 1] - samples_[index]) * fraction;
+    }
+
+    // Integral of the curve from 0 to `time`.
+    float integral(float time) const {
+        float whole = 0.0f;
+        float span = time;
+        if (time > duration_) {
+            if (loop_ && duration_ > 0.0f) {
+                const float cycles = std::floor(time / duration_);
+                whole = cycles * prefix_.back();
+                span = time - cycles * duration_;
+            } else {
+                return prefix_.back() + samples_.back() * (time - duration_);
+            }
+        }
+        if (span <= 0.0f) {
+            return whole + samples_.front() * span;
+        }
+        std::size_t index = 0;
+        float fraction = 0.0f;
+        locate(span, index, fraction);
+        if (index + 1 >= samples_.size()) {
+            return whole + prefix_.back();
+        }
+        const float step = 1.0f / kSampleRate;
+        const float value = samples_[index] + (samples_[index + 1] - samples_[index]) * fraction;
+        return whole + prefix_[index] + 0.5f * (samples_[index] + value) * fraction * step;
+    }
+
+    float max() const { return empty() ? 0.0f : *std::max_element(samples_.begin(), samples_.end()); }
+    float min() const { return empty() ? 0.0f : *std::min_element(samples_.begin(), samples_.end()); }
+
+    // The same curve with `fn` applied to every sample, e.g. degrees to a
+    // slope before integrating.
+    template <typename Fn>
+    Curve map(Fn&& fn) const {
+        Curve result = *this;
+        for (float& sample : result.samples_) {
+            sample = fn(sample);
+        }
+        result.rebuild_integral();
+        return result;
+    }
+
+private:
+    void locate(float time, std::size_t& index, float& fraction) const {
+        if (loop_ && duration_ > 0.0f && time > duration_) {
+            time = std::fmod(time, duration_);
+        }
+        const float position = std::clamp(time, 0.0f, duration_) * kSampleRate;
+        index = std::min(static_cast<std::size_t>(position), samples_.size() - 1U);
+        fraction = position - static_cast<float>(index);
+    }
+
+    void rebuild_integral() {
+        prefix_.assign(samples_.size(), 0.0f);
+        for (std::size_t i = 1; i < samples_.size(); ++i) {
+            prefix_[i] = prefix_[i - 1] + 0.5f * (samples_[i - 1] + samples_[i]) / kSampleRate;
+        }
+    }
+
+    std::vector<float> samples_{};
+    std::vector<float> prefix_{};
+    float duration_{0.0f};
+    bool loop_{false};
+};
+
+// 0xRRGGBBAA color animated channel by channel.
+class ColorCurve {
+public:
+    ColorCurve() = default;
+
+    ColorCurve(const std::vector<std::pair<float, uint32_t>>& keys, bool loop, bool smooth) {
+        for (int channel = 0; channel < 4; ++channel) {
+            const unsigned shift = 24U - 8U * static_cast<unsigned>(channel);
+            std::vector<CurveKey> channel_keys;
+            channel_keys.reserve(keys.size());
+            for (const auto& [time, color] : keys) {
+                channel_keys.push_back(CurveKey{time, static_cast<float>((color >> shift) & 0xFFU)});
+            }
+            channels_[channel] = Curve(std::move(channel_keys), loop, smooth);
+        }
+    }
+
+    bool empty() const { return channels_[0].empty(); }
+
+    uint32_t at(float time) const {
+        uint32_t color = 0;
+        for (int channel = 0; channel < 4; ++channel) {
+            const float value = std::clamp(channels_[channel].at(time), 0.0f, 255.0f);
+            color = (color << 8U) | static_cast<uint32_t>(std::lround(value));
+        }
+        return color;
+    }
+
+private:
+    Curve channels_[4]{};
+};
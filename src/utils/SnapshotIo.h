@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Binary encoding of warm-start snapshots: plain values and arrays of
+// trivially copyable values, in the machine's own byte order and layout.
+// A snapshot is only read back by the build that wrote it, which the file
+// header checks, so nothing is swapped or packed.
+class SnapshotWriter {
+public:
+    void clear() { bytes_.clear(); }
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        append(&value, sizeof(T));
+    }
+
+    // A count followed by the elements of a vector or string.
+    template <typename Container>
+    void put_array(const Container& values) {
+        using T = std::remove_cvref_t<decltype(*std::data(values))>;
+        static_assert(std::is_trivially_copyable_v<T>);
+        put<uint64_t>(std::size(values));
+        append(std::data(values), std::size(values) * sizeof(T));
+    }
+
+    // The encoded bytes. Clearing keeps the capacity, so a writer that is
+    // reused for every snapshot stops allocating once it has grown.
+    std::vector<uint8_t>& bytes() { return bytes_; }
+    const std::vector<uint8_t>& bytes() const { return bytes_; }
+
+private:
+    void append(const void* data, std::size_t size) {
+        const std::size_t at = bytes_.size();
+        bytes_.resize(at + size);
+        if (size > 0) {
+            std::memcpy(bytes_.data() + at, data, size);
+        }
+    }
+
+    std::vector<uint8_t> bytes_{};
+};
+
+// Reads what a SnapshotWriter wrote. Every call fails, and leaves its
+// argument alone, once the data runs out.
+class SnapshotReader {
+public:
+    explicit SnapshotReader(std::span<const uint8_t> bytes) : bytes_(bytes) {}
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (!take(sizeof(T))) {
+            return false;
+        }
+        std::memcpy(&value, bytes_.data() + offset_ - sizeof(T), sizeof(T));
+        return true;
+    }
+
+    // Replaces the contents of a vector or string.
+    template <typename Container>
+    bool get_array(Container& values) {
+        using T = typename Container::value_type;
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint64_t count = 0;
+        if (!get(count) || count > remaining() / sizeof(T)) {
+            failed_ = true;
+            return false;
+        }
+        const std::size_t size = static_cast<std::size_t>(count) * sizeof(T);
+        take(size);
+        values.resize(static_cast<std::size_t>(count));
+        if (size > 0) {
+            std::memcpy(values.data(), bytes_.data() + offset_ - size, size);
+        }
+        return true;
+    }
+
+    // Like get_array(), but only into an array of exactly `values.size()`.
+    template <typename T>
+    bool get_exact(std::span<T> values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint64_t count = 0;
+        if (!get(count) || count != values.size() || !take(values.size_bytes())) {
+            failed_ = true;
+            return false;
+        }
+        if (!values.empty()) {
+            std::memcpy(values.data(), bytes_.data() + offset_ - values.size_bytes(), values.size_bytes());
+        }
+        return true;
+    }
+
+    bool ok() const { return !failed_; }
+    std::size_t remaining() const { return bytes_.size() - offset_; }
+
+private:
+    bool take(std::size_t size) {
+        if (failed_ || size > remaining()) {
+            failed_ = true;
+            return false;
+        }
+        offset_ += size;
+        return true;
+    }
+
+    std::span<const uint8_t> bytes_{};
+    std::size_t offset_{0};
+    bool failed_{false};
+};
+
+// FNV-1a over `bytes`; detects a damaged snapshot and identifies the
+// configuration it belongs to.
+inline uint64_t snapshot_hash(std::span<const uint8_t> bytes, uint64_t hash = 0xCBF29CE484222325ULL) {
+    for (const uint8_t byte : bytes) {
+        hash = (hash ^ byte) * 0x100000001B3ULL;
+    }
+    return hash;
+}
@@ -5,6 +5,8 @@
 #include <string_view>
 #include <vector>
 
+#include <wchar.h>
+
 namespace utf8 {
 namespace detail {
 constexpr bool is_continuation(unsigned char byte) {
@@ -101,5 +103,44 @@ inline std::vector<char32_t> decode(std::string_view input) {
     return result;
 }
 
+// Writes the UTF-8 form of `codepoint` into `out` (at least 4 bytes) and
+// returns the number of bytes written. Invalid codepoints become '?'.
+inline std::size_t encode(char32_t codepoint, char* out) {
+    if (codepoint <= 0x7FU) {
+        out[0] = static_cast<char>(codepoint);
+        return 1;
+    }
+    if (codepoint <= 0x7FFU) {
+        out[0] = static_cast<char>(0xC0U | ((codepoint >> 6U) & 0x1FU));
+        out[1] = static_cast<char>(0x80U | (codepoint & 0x3FU));
+        return 2;
+    }
+    if (codepoint <= 0xFFFFU) {
+        out[0] = static_cast<char>(0xE0U | ((codepoint >> 12U) & 0x0FU));
+        out[1] = static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU));
+        out[2] = static_cast<char>(0x80U | (codepoint & 0x3FU));
+        return 3;
+    }
+    if (codepoint <= 0x10FFFFU) {
+        out[0] = static_cast<char>(0xF0U | ((codepoint >> 18U) & 0x07U));
+        out[1] = static_cast<char>(0x80U | ((codepoint >> 12U) & 0x3FU));
+        out[2] = static_cast<char>(0x80U | ((codepoint >> 6U) & 0x3FU));
+        out[3] = static_cast<char>(0x80U | (codepoint & 0x3FU));
+        return 4;
+    }
+    out[0] = '?';
+    return 1;
+}
+
+// Whether `codepoint` takes exactly one terminal column. Printable Latin
+// text is answered without asking the C library; anything it does not know
+// in the current locale counts as not one column.
+inline bool single_column(char32_t codepoint) {
+    if (codepoint < 0x300U) {
+        return (codepoint >= 0x20U && codepoint < 0x7FU) || codepoint >= 0xA0U;
+    }
+    return ::wcwidth(static_cast<wchar_t>(codepoint)) == 1;
+}
+
 } // namespace utf8
 